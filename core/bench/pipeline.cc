@@ -0,0 +1,227 @@
+#include "pipeline.h"
+#include "codec.h"
+#include "am.h"
+#include "ad.h"
+#include "ck.h"
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace muvr;
+
+static const char *usage =
+        "usage: pebble-pipeline-bench [--watches N] [--seconds S] [--samples K] [--encoding E] [--batch B] [--mutex]\n"
+        "\n"
+        "Pushes the messages of K samples of N watches through the ingestion pipeline for S s and reports\n"
+        "the samples/s, and the samples/s per core of CPU time the pipeline used. --mutex runs the same\n"
+        "work through a mutex-guarded queue to one thread instead, for comparison.\n";
+
+/**
+ * The options of the command line
+ */
+struct options {
+    uint32_t watches = 1000;
+    uint32_t seconds = 5;
+    uint32_t samples = 50;
+    uint8_t encoding = AD_ENCODING_PACKED;
+    size_t batch = 64;
+    bool mutex = false;
+};
+
+/**
+ * What a run pushed through, and the wall and CPU time it took in s
+ */
+struct result {
+    uint64_t messages = 0;
+    uint64_t samples = 0;
+    uint64_t classifications = 0;
+    double wall = 0;
+    double cpu = 0;
+};
+
+static options parse(int argc, char *argv[]) {
+    options result;
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (name == "--mutex") { result.mutex = true; continue; }
+        if (i + 1 == argc) throw std::invalid_argument(name);
+
+        unsigned long value = std::stoul(argv[++i]);
+        if (name == "--watches") result.watches = (uint32_t)value;
+        else if (name == "--seconds") result.seconds = (uint32_t)value;
+        else if (name == "--samples") result.samples = (uint32_t)value;
+        else if (name == "--encoding") result.encoding = (uint8_t)value;
+        else if (name == "--batch") result.batch = value;
+        else throw std::invalid_argument(name);
+    }
+    if (result.watches == 0 || result.seconds == 0 || result.samples == 0 || result.batch == 0) throw std::invalid_argument("zero");
+    return result;
+}
+
+/**
+ * Returns the ``msg_ad`` message of the ``count`` samples of a watch moving at ``frequency``
+ */
+static std::vector<uint8_t> make_message(const options &options, const uint32_t count, const double frequency, const double timestamp) {
+    std::vector<axes> samples;
+    for (uint32_t i = 0; i < count; ++i) {
+        double a = sin(2 * M_PI * frequency * i / 50);
+        samples.push_back(axes { (int16_t)(800 * a), (int16_t)(300 * a), (int16_t)(-1000 + 200 * a * a) });
+    }
+
+    std::vector<uint8_t> payload;
+    switch (options.encoding) {
+        case AD_ENCODING_PACKED: payload = codec::encode<codec::packed13>(samples); break;
+        case AD_ENCODING_ENTROPY: payload = codec::encode<codec::delta>(samples); break;
+        case AD_ENCODING_8_BITS: payload = codec::encode<codec::quantised<8>>(samples, AD_DEFAULT_RANGE); break;
+        case AD_ENCODING_10_BITS: payload = codec::encode<codec::quantised<10>>(samples, AD_DEFAULT_RANGE); break;
+        case AD_ENCODING_12_BITS: payload = codec::encode<codec::quantised<12>>(samples, AD_DEFAULT_RANGE); break;
+        default: throw std::invalid_argument("--encoding");
+    }
+
+    header h;
+    memset(&h, 0, sizeof(header));
+    h.preamble1 = 0x61;
+    h.preamble2 = 0x65;
+    h.types_count = 1;
+    h.samples_per_second = 50;
+    h.timestamp = timestamp;
+    h.sample_interval = 20 << 8;
+    h.encoding = options.encoding;
+    h.range = AD_DEFAULT_RANGE;
+    h.count = count * 3;
+    h.type = AD_TYPE_ACCELEROMETER;
+
+    std::vector<uint8_t> message(reinterpret_cast<uint8_t *>(&h), reinterpret_cast<uint8_t *>(&h) + sizeof(header));
+    message.insert(message.end(), payload.begin(), payload.end());
+    h.crc = ck_message_crc(message.data(), (uint16_t)message.size());
+    memcpy(message.data() + offsetof(header, crc), &h.crc, sizeof(h.crc));
+    return message;
+}
+
+/**
+ * Calls ``submit`` with batches of copies of the ``messages`` of the watches in turn for ``seconds`` s,
+ * as the reader of a socket would, and returns what it submitted
+ */
+template <typename F>
+static result produce(const options &options, const std::vector<std::vector<uint8_t>> &messages, F submit) {
+    result result;
+    std::vector<message> batch(options.batch);
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(options.seconds);
+    for (uint32_t watch = 0; std::chrono::steady_clock::now() < end;) {
+        for (auto &m : batch) {
+            m.watch = watch;
+            m.bytes = messages[watch % messages.size()];
+            watch = (watch + 1) % options.watches;
+        }
+        submit(batch.data(), batch.size());
+        result.messages += batch.size();
+        result.samples += batch.size() * options.samples;
+    }
+    return result;
+}
+
+static result run_pipeline(const options &options, const std::vector<std::vector<uint8_t>> &messages) {
+    pipeline_config config;
+    config.batch_size = options.batch;
+    uint64_t classifications = 0;
+    pipeline pipeline(config, [&classifications](const classification &) { ++classifications; });
+
+    auto start = std::chrono::steady_clock::now();
+    std::clock_t cpu = std::clock();
+    auto result = produce(options, messages, [&pipeline](message *batch, size_t count) { pipeline.submit(batch, count); });
+    pipeline.close();
+    result.cpu = (double)(std::clock() - cpu) / CLOCKS_PER_SEC;
+    result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.classifications = classifications;
+    return result;
+}
+
+/**
+ * The same work through a mutex-guarded queue to one thread that decodes, windows and classifies
+ */
+static result run_mutex(const options &options, const std::vector<std::vector<uint8_t>> &messages) {
+    pipeline_config config;
+    std::mutex mutex;
+    std::condition_variable available, space;
+    std::deque<message> queue;
+    bool done = false;
+    uint64_t classifications = 0;
+
+    std::thread consumer([&]() {
+        std::unordered_map<uint32_t, std::vector<sample>> pending;
+        while (true) {
+            message m;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [&]() { return done || !queue.empty(); });
+                if (queue.empty()) return;
+                m = std::move(queue.front());
+                queue.pop_front();
+                space.notify_one();
+            }
+            auto batch = decode(m.bytes);
+            auto &samples = pending[m.watch];
+            samples.insert(samples.end(), batch.samples.begin(), batch.samples.end());
+            while (samples.size() >= config.window_size) {
+                std::vector<sample> window(samples.begin(), samples.begin() + config.window_size);
+                classify(window, config);
+                ++classifications;
+                samples.erase(samples.begin(), samples.begin() + config.window_step);
+            }
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::clock_t cpu = std::clock();
+    auto result = produce(options, messages, [&](message *batch, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            std::unique_lock<std::mutex> lock(mutex);
+            // as deep as the first ring of the pipeline
+            space.wait(lock, [&]() { return queue.size() < 1024; });
+            queue.push_back(std::move(batch[i]));
+            available.notify_one();
+        }
+    });
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        available.notify_one();
+    }
+    consumer.join();
+    result.cpu = (double)(std::clock() - cpu) / CLOCKS_PER_SEC;
+    result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.classifications = classifications;
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    try {
+        options options = parse(argc, argv);
+        // 16 movements, each at a different point of its cycle
+        std::vector<std::vector<uint8_t>> messages;
+        for (uint32_t i = 0; i < 16; ++i) messages.push_back(make_message(options, options.samples, 0.5 + i / 10.0, 1449000000 + i));
+
+        auto result = options.mutex ? run_mutex(options, messages) : run_pipeline(options, messages);
+        printf("Ingestion     %s, %u watches, %u samples per message, encoding %u, %u cores\n",
+               options.mutex ? "mutex and queue" : "SPSC pipeline", options.watches, options.samples, options.encoding,
+               std::thread::hardware_concurrency());
+        printf("Processed     %llu messages, %llu samples, %llu windows in %.2f s\n",
+               (unsigned long long)result.messages, (unsigned long long)result.samples, (unsigned long long)result.classifications, result.wall);
+        printf("Throughput    %.0f samples/s, %.0f msg/s\n", result.samples / result.wall, result.messages / result.wall);
+        printf("Per core      %.0f samples/s over %.2f s of CPU time (%.2f cores busy)\n",
+               result.samples / result.cpu, result.cpu, result.cpu / result.wall);
+        return 0;
+    } catch (const std::invalid_argument &e) {
+        fprintf(stderr, "Bad option %s\n%s", e.what(), usage);
+        return 2;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace muvr {
+
+    namespace fleet {
+
+        ///
+        /// The frame of one ``msg_ad`` message on the socket from pebble-fleet to the ingestion stand-in,
+        /// followed by the ``size`` B of the message. Both ends run on the same host, so the fields are
+        /// in its byte order and ``sent`` is its steady clock.
+        ///
+        struct __attribute__((__packed__)) frame_header {
+            // the size of the message in B
+            uint32_t size;
+            // the simulated watch that sent it
+            uint32_t watch;
+            // the steady clock time of the sending in ns
+            uint64_t sent;
+        };
+
+        ///
+        /// Returns the steady clock time in ns.
+        ///
+        inline uint64_t steady_ns() {
+            using namespace std::chrono;
+            return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        }
+
+        ///
+        /// Appends the frame of the ``size`` B ``message`` of the ``watch`` to the ``frames``.
+        ///
+        inline void append_frame(std::vector<uint8_t> &frames, const uint32_t watch, const uint8_t *message, const uint32_t size) {
+            frame_header header { size, watch, steady_ns() };
+            const uint8_t *h = reinterpret_cast<const uint8_t *>(&header);
+            frames.insert(frames.end(), h, h + sizeof(frame_header));
+            frames.insert(frames.end(), message, message + size);
+        }
+
+    }
+
+}
@@ -0,0 +1,116 @@
+#include "ingest.h"
+#include "frame.h"
+#include "decoder.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muvr::fleet;
+
+uint32_t ingest_report::percentile(const double p) const {
+    if (latencies.empty()) return 0;
+    size_t i = (size_t)(p / 100 * (latencies.size() - 1) + 0.5);
+    return latencies[std::min(i, latencies.size() - 1)];
+}
+
+///
+/// Reads the frames from the ``connection`` until it is closed, decoding their messages into the ``report``.
+///
+static void read_connection(const int connection, ingest_report &report) {
+    std::vector<uint8_t> buffer(1 << 16);
+    size_t filled = 0;
+    uint64_t start = steady_ns();
+    while (true) {
+        if (filled == buffer.size()) buffer.resize(buffer.size() * 2);
+        ssize_t n = recv(connection, buffer.data() + filled, buffer.size() - filled, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        filled += n;
+
+        size_t position = 0;
+        while (filled - position >= sizeof(frame_header)) {
+            frame_header header;
+            memcpy(&header, buffer.data() + position, sizeof(frame_header));
+            if (filled - position - sizeof(frame_header) < header.size) break;
+
+            const uint8_t *message = buffer.data() + position + sizeof(frame_header);
+            try {
+                auto batch = muvr::decode(std::vector<uint8_t>(message, message + header.size));
+                report.samples += batch.samples.size();
+            } catch (const std::invalid_argument &) {
+                ++report.malformed;
+            }
+            uint64_t decoded = steady_ns();
+            report.latencies.push_back((uint32_t)std::min<uint64_t>((decoded - header.sent) / 1000, UINT32_MAX));
+            ++report.messages;
+            report.bytes += header.size;
+            position += sizeof(frame_header) + header.size;
+        }
+        memmove(buffer.data(), buffer.data() + position, filled - position);
+        filled -= position;
+    }
+    close(connection);
+    report.duration = (steady_ns() - start) / 1e9;
+}
+
+ingest::ingest(const uint16_t port) {
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_socket < 0) throw std::runtime_error(strerror(errno));
+
+    int reuse = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if (bind(m_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(m_socket, 128) != 0 ||
+        getsockname(m_socket, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        std::string error = strerror(errno);
+        close(m_socket);
+        throw std::runtime_error(error);
+    }
+    m_port = ntohs(address.sin_port);
+}
+
+ingest::~ingest() {
+    close(m_socket);
+}
+
+uint16_t ingest::port() const {
+    return m_port;
+}
+
+ingest_report ingest::serve(const size_t connections) {
+    std::vector<ingest_report> reports(connections);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < connections; ++i) {
+        int connection = accept(m_socket, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR) { --i; continue; }
+            break;
+        }
+        readers.emplace_back(read_connection, connection, std::ref(reports[i]));
+    }
+    for (auto &reader : readers) reader.join();
+
+    ingest_report result;
+    for (auto &report : reports) {
+        result.messages += report.messages;
+        result.samples += report.samples;
+        result.bytes += report.bytes;
+        result.malformed += report.malformed;
+        result.latencies.insert(result.latencies.end(), report.latencies.begin(), report.latencies.end());
+        result.duration = std::max(result.duration, report.duration);
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
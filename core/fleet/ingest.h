@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace muvr {
+
+    namespace fleet {
+
+        ///
+        /// What the ingestion stand-in received
+        ///
+        struct ingest_report {
+            uint64_t messages = 0;
+            uint64_t samples = 0;
+            uint64_t bytes = 0;
+            // the messages ``muvr::decode`` rejected
+            uint64_t malformed = 0;
+            // the time from the watch's sending to the decoded batch of every message in µs
+            std::vector<uint32_t> latencies;
+            // the time the connections were open in s
+            double duration = 0;
+
+            ///
+            /// Returns the ``p``-th percentile of the ``latencies`` in µs; ``latencies`` must be sorted.
+            ///
+            uint32_t percentile(const double p) const;
+        };
+
+        ///
+        /// The stand-in of the ingestion backend: it decodes the framed ``msg_ad`` messages
+        /// from its connections, one thread per connection, and keeps the statistics.
+        ///
+        class ingest {
+        public:
+            ///
+            /// Listens on the loopback ``port``, 0 for any free port.
+            ///
+            /// Throws ``std::runtime_error`` if the port cannot be opened
+            ///
+            explicit ingest(const uint16_t port);
+            ~ingest();
+
+            ingest(const ingest &) = delete;
+            ingest &operator=(const ingest &) = delete;
+
+            ///
+            /// Returns the port it listens on.
+            ///
+            uint16_t port() const;
+
+            ///
+            /// Accepts ``connections`` connections and reads them until they are closed.
+            ///
+            /// Returns what was received, the ``latencies`` sorted
+            ///
+            ingest_report serve(const size_t connections);
+
+        private:
+            int m_socket;
+            uint16_t m_port;
+        };
+
+    }
+
+}
@@ -0,0 +1,297 @@
+#include "ingest.h"
+#include "frame.h"
+#include "shim.h"
+#include "watch.h"
+#include "mm.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muvr::fleet;
+
+static const char *usage =
+        "usage: pebble-fleet [--watches N] [--seconds S] [--threads T] [--rate HZ] [--maximum-time MS]\n"
+        "                    [--encoding E] [--range MG] [--replay session.csv] [--signal S] [--fast] [--connect PORT]\n"
+        "                    [--virtual [--latency MS] [--loss PERCENT]]\n"
+        "       pebble-fleet --ingest PORT --connections T\n"
+        "\n"
+        "Simulates N watches running the capture and transport code, T threads of them, and sends their\n"
+        "messages to the ingestion stand-in: its own, or the one listening on the loopback PORT.\n"
+        "--fast sends as fast as the stand-in reads, rather than at the watches' pace. --virtual runs the watches\n"
+        "on one thread in virtual time, with a link of the given latency and losses, simulating S s as fast as it can.\n"
+        "--signal feeds the watches the SG_SIGNAL_* signal of the watch code, 5 playing the replay.\n";
+
+/**
+ * The options of the command line
+ */
+struct options {
+    uint32_t watches = 100;
+    uint32_t seconds = 10;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    session recording;
+    std::string replay;
+    bool fast = false;
+    bool virtual_time = false;
+    link_model link;
+    uint16_t connect = 0;
+    uint16_t ingest = 0;
+    uint32_t connections = 0;
+};
+
+/**
+ * The watches of one thread and their connection to the ingestion stand-in
+ */
+struct shard {
+    std::vector<std::unique_ptr<watch>> watches;
+    int connection = -1;
+    outbox sent;
+    // the writes that waited for the stand-in to read, and the time they waited in s
+    uint64_t stalls = 0;
+    double stalled = 0;
+    // the ticks that took longer than the time they simulate
+    uint64_t late_ticks = 0;
+};
+
+static options parse(int argc, char *argv[]) {
+    options result;
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (name == "--fast") { result.fast = true; continue; }
+        if (name == "--virtual") { result.virtual_time = true; continue; }
+        if (i + 1 == argc) throw std::invalid_argument(name);
+
+        unsigned long value = name == "--replay" || name == "--loss" ? 0 : std::stoul(argv[i + 1]);
+        if (name == "--watches") result.watches = (uint32_t)value;
+        else if (name == "--seconds") result.seconds = (uint32_t)value;
+        else if (name == "--threads") result.threads = (uint32_t)value;
+        else if (name == "--rate") result.recording.samples_per_second = (uint8_t)value;
+        else if (name == "--maximum-time") result.recording.maximum_time = (uint16_t)value;
+        else if (name == "--encoding") result.recording.encoding = (uint8_t)value;
+        else if (name == "--range") result.recording.range = (uint16_t)value;
+        else if (name == "--replay") result.replay = argv[i + 1];
+        else if (name == "--signal") result.recording.signal = (uint8_t)value;
+        else if (name == "--latency") result.link.latency = (uint32_t)value;
+        else if (name == "--loss") result.link.loss = std::stod(argv[i + 1]) / 100;
+        else if (name == "--connect") result.connect = (uint16_t)value;
+        else if (name == "--ingest") result.ingest = (uint16_t)value;
+        else if (name == "--connections") result.connections = (uint32_t)value;
+        else throw std::invalid_argument(name);
+        ++i;
+    }
+    if (result.watches == 0 || result.seconds == 0 || result.threads == 0) throw std::invalid_argument("zero");
+    if (result.recording.signal > SG_SIGNAL_PATTERN || (result.recording.signal == SG_SIGNAL_PATTERN && result.replay.empty())) {
+        throw std::invalid_argument("--signal");
+    }
+    result.threads = std::min(result.threads, result.watches);
+    // the outbox handlers of the watch code visit all its pipelines
+    if (result.virtual_time) result.threads = 1;
+    return result;
+}
+
+static int connect_to(const uint16_t port) {
+    int connection = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (connection < 0 || connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error(std::string("cannot connect to the ingestion: ") + strerror(errno));
+    }
+    return connection;
+}
+
+/**
+ * Writes the frames of the ``shard``'s outbox to its connection, counting the writes that
+ * had to wait for the stand-in to read.
+ */
+static void flush(shard &shard) {
+    auto &frames = shard.sent.frames;
+    size_t written = 0;
+    while (written < frames.size()) {
+        ssize_t n = send(shard.connection, frames.data() + written, frames.size() - written, MSG_DONTWAIT);
+        if (n > 0) {
+            written += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++shard.stalls;
+            uint64_t start = steady_ns();
+            pollfd writable { shard.connection, POLLOUT, 0 };
+            poll(&writable, 1, -1);
+            shard.stalled += (steady_ns() - start) / 1e9;
+        } else if (n < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("cannot send to the ingestion: ") + strerror(errno));
+        }
+    }
+    frames.clear();
+}
+
+/**
+ * Runs the ``shard``'s watches for ``ticks`` ticks of ``AD_NUM_SAMPLES`` samples each, at the pace
+ * of the watches unless ``fast``.
+ */
+static void run(shard &shard, const uint32_t ticks, const uint8_t samples_per_second, const bool fast) {
+    set_outbox(&shard.sent);
+    auto tick = std::chrono::microseconds(AD_NUM_SAMPLES * 1000000 / samples_per_second);
+    auto next = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ticks; ++i) {
+        for (auto &watch : shard.watches) watch->tick(shard.sent, AD_NUM_SAMPLES);
+        flush(shard);
+
+        if (fast) continue;
+        next += tick;
+        if (std::chrono::steady_clock::now() > next) ++shard.late_ticks;
+        else std::this_thread::sleep_until(next);
+    }
+    set_outbox(nullptr);
+}
+
+/**
+ * Runs the ``shard``'s watches for ``seconds`` s of the virtual time of the ``clock``, writing the frames
+ * to the stand-in after every simulated second; every watch ticks at its pace, the first ticks spread
+ * over the period. Then stops the watches and delivers their last messages.
+ */
+static void simulate(shard &shard, muvr::virtual_clock &clock, const uint32_t seconds, const uint8_t samples_per_second) {
+    const uint64_t period = AD_NUM_SAMPLES * 1000 / samples_per_second;
+    std::vector<muvr::virtual_clock::event_id> ticks(shard.watches.size());
+    std::function<void(size_t)> tick = [&](const size_t i) {
+        shard.watches[i]->tick(shard.sent, AD_NUM_SAMPLES);
+        ticks[i] = clock.schedule(period, [&tick, i]() { tick(i); });
+    };
+    for (size_t i = 0; i < shard.watches.size(); ++i) ticks[i] = clock.schedule(i % period, [&tick, i]() { tick(i); });
+
+    const uint64_t start = clock.now();
+    for (uint32_t second = 1; second <= seconds; ++second) {
+        clock.run_until(start + second * 1000);
+        flush(shard);
+    }
+
+    for (auto id : ticks) clock.cancel(id);
+    shard.watches.clear();
+    while (clock.pending() > 0) clock.run_until(clock.now() + 1000);
+    flush(shard);
+}
+
+static void print(const ingest_report &report) {
+    printf("Ingested      %llu messages, %llu samples, %llu malformed, %.0f msg/s, %.2f MB/s\n",
+           (unsigned long long)report.messages, (unsigned long long)report.samples, (unsigned long long)report.malformed,
+           report.duration > 0 ? report.messages / report.duration : 0, report.duration > 0 ? report.bytes / report.duration / 1e6 : 0);
+    printf("Latency       p50 %u µs, p90 %u µs, p99 %u µs, p99.9 %u µs, max %u µs\n",
+           report.percentile(50), report.percentile(90), report.percentile(99), report.percentile(99.9), report.percentile(100));
+}
+
+static int serve(const options &options) {
+    if (options.connections == 0) throw std::invalid_argument("--connections");
+    ingest ingest(options.ingest);
+    printf("Listening on %u for %u connections\n", ingest.port(), options.connections);
+    while (true) {
+        print(ingest.serve(options.connections));
+        fflush(stdout);
+    }
+}
+
+static int load(const options &options) {
+    if (options.watches > MM_AM_INSTANCES) {
+        fprintf(stderr, "At most %d watches; build with a larger PEBBLE_FLEET_WATCHES\n", MM_AM_INSTANCES);
+        return 1;
+    }
+    std::vector<AccelRawData> replay;
+    if (!options.replay.empty()) replay = read_session(options.replay);
+
+    std::unique_ptr<ingest> own_ingest;
+    std::future<ingest_report> ingested;
+    uint16_t port = options.connect;
+    if (port == 0) {
+        own_ingest.reset(new ingest(0));
+        port = own_ingest->port();
+        ingested = std::async(std::launch::async, &ingest::serve, own_ingest.get(), (size_t)options.threads);
+    }
+
+    // the virtual time starts at the same time every run
+    muvr::virtual_clock virtual_time(1449000000000);
+    if (options.virtual_time) set_clock(&virtual_time, options.link);
+
+    // the pools of the watch code are not shared by the threads; only the ticks run in parallel
+    std::vector<shard> shards(options.threads);
+    for (uint32_t i = 0; i < options.watches; ++i) {
+        auto &shard = shards[i % options.threads];
+        // the timers the watch code registers in the virtual time belong to the watch
+        set_outbox(options.virtual_time ? &shard.sent : nullptr);
+        shard.sent.watch = i;
+        shard.watches.emplace_back(new watch(i, options.recording, replay));
+    }
+    set_outbox(nullptr);
+    for (auto &shard : shards) shard.connection = connect_to(port);
+
+    uint32_t ticks = options.seconds * options.recording.samples_per_second / AD_NUM_SAMPLES;
+    uint64_t start = steady_ns();
+    if (options.virtual_time) {
+        set_outbox(&shards[0].sent);
+        simulate(shards[0], virtual_time, options.seconds, options.recording.samples_per_second);
+    } else {
+        std::vector<std::thread> threads;
+        for (auto &shard : shards) threads.emplace_back(run, std::ref(shard), ticks, options.recording.samples_per_second, options.fast);
+        for (auto &thread : threads) thread.join();
+    }
+    double duration = (steady_ns() - start) / 1e9;
+
+    // the last partial batches
+    for (auto &shard : shards) {
+        set_outbox(&shard.sent);
+        shard.watches.clear();
+        flush(shard);
+        close(shard.connection);
+    }
+    set_outbox(nullptr);
+    set_clock(nullptr, options.link);
+
+    uint64_t messages = 0, bytes = 0, lost = 0, stalls = 0, late_ticks = 0;
+    double stalled = 0;
+    for (auto &shard : shards) {
+        messages += shard.sent.messages;
+        bytes += shard.sent.bytes;
+        lost += shard.sent.lost;
+        stalls += shard.stalls;
+        stalled += shard.stalled;
+        late_ticks += shard.late_ticks;
+    }
+    printf("Watches       %u at %u Hz, %u threads, %u s simulated in %.2f s\n",
+           options.watches, options.recording.samples_per_second, options.threads, options.seconds, duration);
+    printf("Sent          %llu messages, %.0f msg/s, %.2f MB/s, %llu late ticks\n",
+           (unsigned long long)messages, messages / duration, bytes / duration / 1e6, (unsigned long long)late_ticks);
+    if (options.virtual_time) {
+        printf("Virtual time  %u s simulated %.0fx faster, %u ms link latency, %llu messages lost\n",
+               options.seconds, options.seconds / duration, options.link.latency, (unsigned long long)lost);
+    }
+    printf("Backpressure  %llu stalled writes, %.3f s stalled\n", (unsigned long long)stalls, stalled);
+    if (own_ingest) print(ingested.get());
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // a closed stand-in fails the send rather than the process
+    signal(SIGPIPE, SIG_IGN);
+    try {
+        options options = parse(argc, argv);
+        return options.ingest != 0 ? serve(options) : load(options);
+    } catch (const std::invalid_argument &e) {
+        fprintf(stderr, "Bad option %s\n%s", e.what(), usage);
+        return 2;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
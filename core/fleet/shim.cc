@@ -0,0 +1,200 @@
+#include "shim.h"
+#include "frame.h"
+#include "am.h"
+#include <unordered_map>
+
+extern "C" {
+#include <pebble.h>
+}
+
+using namespace muvr::fleet;
+using muvr::virtual_clock;
+
+// the outbox of the thread, the msg_ad payload of the message being written, and the context of its handlers
+static thread_local outbox *current;
+static thread_local DictionaryIterator iterator;
+static thread_local std::vector<uint8_t> message;
+static thread_local void *message_context;
+
+// the virtual time: the clock, the link, the time every watch's outbox is free again,
+// the outbox handlers of the watch code, and the state of the losses
+static virtual_clock *virtual_time;
+static link_model current_link;
+static std::unordered_map<uint32_t, uint64_t> outbox_free;
+static AppMessageOutboxSent sent_handler;
+static AppMessageOutboxFailed failed_handler;
+static uint32_t random_state;
+
+void muvr::fleet::set_outbox(outbox *outbox) {
+    current = outbox;
+}
+
+void muvr::fleet::set_clock(virtual_clock *clock, const link_model &link) {
+    virtual_time = clock;
+    current_link = link;
+    outbox_free.clear();
+    random_state = 1;
+}
+
+/**
+ * Returns the watch whose code runs now
+ */
+static uint32_t current_watch() {
+    return current == nullptr ? 0 : current->watch;
+}
+
+/**
+ * Runs the watch code of the ``watch``
+ */
+static void resume_watch(const uint32_t watch) {
+    if (current != nullptr) current->watch = watch;
+}
+
+/**
+ * Returns ``true`` if the link loses the next message; the same messages every run
+ */
+static bool lose() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return (random_state >> 8) < current_link.loss * (1u << 24);
+}
+
+/**
+ * Sends the ``message`` of the current watch in the virtual time
+ */
+static void send_later(std::vector<uint8_t> &&message) {
+    const uint32_t watch = current_watch();
+    const bool lost = lose();
+    void *context = message_context;
+    outbox_free[watch] = virtual_time->now() + current_link.latency;
+    virtual_time->schedule(current_link.latency, [watch, lost, message, context]() {
+        resume_watch(watch);
+        if (lost) {
+            if (current != nullptr) ++current->lost;
+            if (failed_handler != nullptr) failed_handler(&iterator, APP_MSG_SEND_TIMEOUT, context);
+            return;
+        }
+        // the ingestion takes the sample batches only
+        if (current != nullptr && !message.empty()) {
+            append_frame(current->frames, watch, message.data(), (uint32_t)message.size());
+            ++current->messages;
+            current->bytes += message.size();
+        }
+        if (sent_handler != nullptr) sent_handler(&iterator, context);
+    });
+}
+
+extern "C" {
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **result) {
+    if (current == nullptr) return APP_MSG_NOT_CONNECTED;
+    if (virtual_time != nullptr && outbox_free[current->watch] > virtual_time->now()) return APP_MSG_BUSY;
+    message.clear();
+    *result = &iterator;
+    return APP_MSG_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *, const uint32_t key, const uint8_t * const data, const uint16_t size) {
+    // the ingestion takes the sample batches only
+    if (key == msg_ad) message.assign(data, data + size);
+    return DICT_OK;
+}
+
+uint32_t dict_write_end(DictionaryIterator *) {
+    return (uint32_t)message.size();
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    if (current == nullptr) return APP_MSG_NOT_CONNECTED;
+    if (virtual_time != nullptr) {
+        send_later(std::move(message));
+        message.clear();
+        return APP_MSG_OK;
+    }
+    if (!message.empty()) {
+        append_frame(current->frames, current->watch, message.data(), (uint32_t)message.size());
+        ++current->messages;
+        current->bytes += message.size();
+        message.clear();
+    }
+    // sent right away, so the outbox is free for the next message
+    if (sent_handler != nullptr) sent_handler(&iterator, message_context);
+    return APP_MSG_OK;
+}
+
+void *app_message_get_context(void) {
+    return message_context;
+}
+
+void *app_message_set_context(void *context) {
+    void *previous = message_context;
+    message_context = context;
+    return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent handler) {
+    AppMessageOutboxSent previous = sent_handler;
+    sent_handler = handler;
+    return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed handler) {
+    AppMessageOutboxFailed previous = failed_handler;
+    failed_handler = handler;
+    return previous;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *data) {
+    if (virtual_time == nullptr) return nullptr;
+
+    const uint32_t watch = current_watch();
+    auto id = virtual_time->schedule(timeout_ms, [watch, callback, data]() {
+        resume_watch(watch);
+        callback(data);
+    });
+    return reinterpret_cast<AppTimer *>(id);
+}
+
+void app_timer_cancel(AppTimer *timer) {
+    if (virtual_time != nullptr && timer != nullptr) virtual_time->cancel(reinterpret_cast<virtual_clock::event_id>(timer));
+}
+
+void psleep(int ms) {
+    if (virtual_time != nullptr && ms > 0) virtual_time->sleep((uint32_t)ms);
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+    uint64_t now = virtual_time != nullptr ? virtual_time->now() : (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    if (t_utc != nullptr) *t_utc = (time_t)(now / 1000);
+    if (out_ms != nullptr) *out_ms = (uint16_t)(now % 1000);
+    return (uint16_t)(now % 1000);
+}
+
+size_t heap_bytes_used(void) {
+    return 0;
+}
+
+void connection_service_subscribe(ConnectionHandlers) {
+}
+
+void connection_service_unsubscribe(void) {
+}
+
+bool connection_service_peek_pebble_app_connection(void) {
+    return true;
+}
+
+void accel_raw_data_service_subscribe(uint32_t, AccelRawDataHandler) {
+}
+
+void accel_data_service_unsubscribe(void) {
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate) {
+    return 0;
+}
+
+void app_log(uint8_t, const char *, int, const char *, ...) {
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "clock.h"
+
+namespace muvr {
+
+    namespace fleet {
+
+        ///
+        /// The messages sent by the watches of one thread, as the frames for the ingestion stand-in
+        ///
+        struct outbox {
+            // the watch whose code runs now
+            uint32_t watch = 0;
+            // the frames not yet written to the socket
+            std::vector<uint8_t> frames;
+            // the number of messages and their B since the start
+            uint64_t messages = 0;
+            uint64_t bytes = 0;
+            // the messages the link lost
+            uint64_t lost = 0;
+        };
+
+        ///
+        /// The Bluetooth link of every watch in virtual time
+        ///
+        struct link_model {
+            // the time in ms a message occupies the watch's outbox until it is sent
+            uint32_t latency = 30;
+            // the share of the messages lost, deterministically
+            double loss = 0;
+        };
+
+        ///
+        /// Routes the messages the watch code sends on the calling thread to the ``outbox``;
+        /// ``nullptr`` makes the sends fail as if the phone were not connected.
+        ///
+        /// In the wall time the host Pebble API of pebble-fleet keeps no state shared by the threads:
+        /// the App Messages go to the thread's outbox at once and call the outbox sent handler, the
+        /// timers never fire and the services deliver nothing, as the watches push their own samples.
+        ///
+        void set_outbox(outbox *outbox);
+
+        ///
+        /// Runs the host Pebble API in the virtual time of the ``clock``, ``nullptr`` in the wall time.
+        ///
+        /// In the virtual time ``time_ms`` and ``psleep`` use the ``clock``, and the app timers are its
+        /// events. A sent message occupies the watch's outbox for the ``link``'s latency, then reaches
+        /// the outbox set on the thread, or is lost, and the watch code's outbox sent or failed handler
+        /// is called with the context of the message. The timers and the handlers run as the watch that
+        /// registered or sent them. The clock and the link are shared, so the virtual time runs on one thread.
+        ///
+        void set_clock(virtual_clock *clock, const link_model &link);
+
+    }
+
+}
@@ -0,0 +1,106 @@
+#include "watch.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace muvr::fleet;
+
+watch::watch(const uint32_t id, const session &session, const std::vector<AccelRawData> &replay):
+        m_id(id), m_samples_per_second(session.samples_per_second), m_ad(nullptr), m_am(nullptr), m_replay(replay) {
+    m_ad = ad_open();
+    m_am = am_start(AD_TYPE_ACCELEROMETER, session.samples_per_second, sizeof(threed_data));
+    if (m_ad == nullptr || m_am == nullptr) {
+        ad_close(m_ad);
+        am_stop(m_am);
+        throw std::runtime_error("no free pipelines; build with a larger PEBBLE_FLEET_WATCHES");
+    }
+    am_set_encoding(m_am, session.encoding, session.range);
+    if (ad_start(m_ad, am_sink(m_am), session.samples_per_second, session.maximum_time) != 1 ||
+        ad_set_encoding(m_ad, session.encoding, session.range) != 0) {
+        ad_close(m_ad);
+        am_stop(m_am);
+        throw std::runtime_error("bad session");
+    }
+
+    // the watches start at different points of the replay, and move at different speeds
+    m_position = m_replay.empty() ? 0 : (id * 7919) % m_replay.size();
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    m_time = (double)seconds * 1000 + ms;
+    m_random = id * 2654435761u + 1;
+    m_frequency = 0.5 + (id % 16) / 10.0;
+    m_phase = id * 0.7;
+
+    m_generator = sg_generator();
+    sg_set_pattern(&m_generator, m_replay.data(), (uint16_t)std::min<size_t>(m_replay.size(), UINT16_MAX), session.samples_per_second);
+    if (sg_start(&m_generator, session.signal, id) != 0) {
+        ad_close(m_ad);
+        am_stop(m_am);
+        throw std::runtime_error("bad signal");
+    }
+}
+
+watch::~watch() {
+    ad_close(m_ad);
+    am_stop(m_am);
+}
+
+AccelRawData watch::next_sample() {
+    if (!m_replay.empty()) {
+        AccelRawData sample = m_replay[m_position];
+        m_position = (m_position + 1) % m_replay.size();
+        return sample;
+    }
+
+    // a repetition of an exercise with the gravity on z, and some sensor noise
+    double t = (double)m_position++ / m_samples_per_second;
+    double a = std::sin(2 * M_PI * m_frequency * t + m_phase);
+    m_random = m_random * 1664525u + 1013904223u;
+    int16_t noise = (int16_t)((m_random >> 24) % 41) - 20;
+    return AccelRawData {
+            (int16_t)(800 * a + noise),
+            (int16_t)(300 * std::cos(2 * M_PI * m_frequency * t) - noise),
+            (int16_t)(-1000 + 200 * a * a + noise)
+    };
+}
+
+void watch::tick(outbox &outbox, const uint32_t count) {
+    m_samples.resize(count);
+    if (m_generator.signal == SG_SIGNAL_NONE) {
+        for (auto &sample : m_samples) sample = next_sample();
+    } else {
+        sg_fill(&m_generator, m_samples.data(), count, (uint64_t)m_time, (uint16_t)((1000 << 8) / m_samples_per_second));
+    }
+
+    outbox.watch = m_id;
+    ad_push(m_ad, m_samples.data(), count, (uint64_t)m_time);
+    m_time += count * 1000.0 / m_samples_per_second;
+}
+
+std::vector<AccelRawData> muvr::fleet::read_session(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error("cannot read " + path);
+
+    std::vector<AccelRawData> samples;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::vector<std::string> columns;
+        std::stringstream stream(line);
+        std::string column;
+        while (std::getline(stream, column, ',')) columns.push_back(column);
+        if (columns.size() < 3) continue;
+
+        try {
+            size_t n = columns.size();
+            samples.push_back(AccelRawData { (int16_t)std::stoi(columns[n - 3]), (int16_t)std::stoi(columns[n - 2]), (int16_t)std::stoi(columns[n - 1]) });
+        } catch (const std::invalid_argument &) {
+            // the header line
+        }
+    }
+    if (samples.empty()) throw std::runtime_error("no samples in " + path);
+
+    return samples;
+}
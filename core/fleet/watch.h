@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ad.h"
+#include "am.h"
+#include "sg.h"
+#include "shim.h"
+
+namespace muvr {
+
+    namespace fleet {
+
+        ///
+        /// The session of every simulated watch
+        ///
+        struct session {
+            uint8_t samples_per_second = AM_DEFAULT_SAMPLES_PER_SECOND;
+            uint16_t maximum_time = AM_DEFAULT_MAXIMUM_TIME;
+            uint8_t encoding = AD_ENCODING_PACKED;
+            uint16_t range = AD_DEFAULT_RANGE;
+            // the SG_SIGNAL_* of the samples, SG_SIGNAL_NONE for the synthetic movement or the replay
+            uint8_t signal = SG_SIGNAL_NONE;
+        };
+
+        ///
+        /// One simulated watch: a capture and a transport pipeline of the watch code, fed with
+        /// synthetic movement or with the samples of a recorded session.
+        ///
+        /// The pipelines come from the pools of the watch code, so the watches are constructed and
+        /// destroyed on one thread; ``tick`` touches the watch's own pipelines only.
+        ///
+        class watch {
+        public:
+            ///
+            /// Starts the pipelines of the watch ``id`` in the ``session``; the ``replay`` samples,
+            /// if not empty, are used instead of the synthetic movement. The ``session``'s signal,
+            /// seeded with the ``id``, replaces both; its pattern is the ``replay``.
+            ///
+            /// Throws ``std::runtime_error`` if the pools have no free pipelines
+            ///
+            watch(const uint32_t id, const session &session, const std::vector<AccelRawData> &replay);
+
+            ///
+            /// Stops the pipelines, sending the last partial batch to the ``outbox`` set on the calling thread.
+            ///
+            ~watch();
+
+            watch(const watch &) = delete;
+            watch &operator=(const watch &) = delete;
+
+            ///
+            /// Captures the next ``count`` samples, sending the complete batches to the ``outbox``.
+            ///
+            void tick(outbox &outbox, const uint32_t count);
+
+        private:
+            AccelRawData next_sample();
+
+            uint32_t m_id;
+            uint8_t m_samples_per_second;
+            ad_t *m_ad;
+            am_t *m_am;
+            const std::vector<AccelRawData> &m_replay;
+            // the position in the replay, or the number of synthetic samples so far
+            size_t m_position;
+            // the time of the next sample in ms since the epoch
+            double m_time;
+            // the movement of the synthetic samples
+            double m_frequency;
+            double m_phase;
+            uint32_t m_random;
+            sg_generator m_generator;
+            std::vector<AccelRawData> m_samples;
+        };
+
+        ///
+        /// Reads the samples of the session in the CSV file at ``path``: the x, y, z values of one
+        /// sample per line in the last three columns, as written by the phone app.
+        ///
+        /// Throws ``std::runtime_error`` if the file cannot be read or holds no samples
+        ///
+        std::vector<AccelRawData> read_session(const std::string &path);
+
+    }
+
+}
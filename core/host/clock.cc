@@ -0,0 +1,53 @@
+#include "clock.h"
+
+using namespace muvr;
+
+virtual_clock::virtual_clock(const uint64_t start): m_now(start), m_slept(0), m_next_id(1) {
+}
+
+uint64_t virtual_clock::now() const {
+    return m_now + m_slept;
+}
+
+void virtual_clock::sleep(const uint32_t ms) {
+    m_slept += ms;
+}
+
+virtual_clock::event_id virtual_clock::schedule(const uint64_t delay, std::function<void()> event) {
+    const event_id id = m_next_id++;
+    const uint64_t time = now() + delay;
+    m_events.emplace(std::make_pair(time, id), std::move(event));
+    m_times.emplace(id, time);
+    return id;
+}
+
+bool virtual_clock::cancel(const event_id id) {
+    auto time = m_times.find(id);
+    if (time == m_times.end()) return false;
+
+    m_events.erase(std::make_pair(time->second, id));
+    m_times.erase(time);
+    return true;
+}
+
+size_t virtual_clock::run_until(const uint64_t time) {
+    size_t fired = 0;
+    while (!m_events.empty() && m_events.begin()->first.first <= time) {
+        auto first = m_events.begin();
+        m_now = first->first.first;
+        m_slept = 0;
+        std::function<void()> event = std::move(first->second);
+        m_times.erase(first->first.second);
+        m_events.erase(first);
+
+        event();
+        ++fired;
+    }
+    if (time > m_now) m_now = time;
+    m_slept = 0;
+    return fired;
+}
+
+size_t virtual_clock::pending() const {
+    return m_events.size();
+}
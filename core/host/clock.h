@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace muvr {
+
+    ///
+    /// A deterministic clock for simulating the watch code. The time moves only when ``run_until``
+    /// fires the events scheduled up to a time, or when the running event ``sleep``s. The events
+    /// fire in the order of their times, and of their scheduling for equal times, so that a
+    /// simulation is the same every run.
+    ///
+    /// A ``sleep`` blocks the running event only: the time it sees moves on, but no other event
+    /// fires meanwhile, and the next event starts at its own time, as if the events ran on
+    /// separate watches.
+    ///
+    class virtual_clock {
+    public:
+        typedef uint64_t event_id;
+
+        ///
+        /// Starts the clock at ``start`` ms since the epoch.
+        ///
+        explicit virtual_clock(const uint64_t start);
+
+        virtual_clock(const virtual_clock &) = delete;
+        virtual_clock &operator=(const virtual_clock &) = delete;
+
+        ///
+        /// Returns the time in ms since the epoch: the time of the running event and the time it slept.
+        ///
+        uint64_t now() const;
+
+        ///
+        /// Blocks the running event for ``ms`` ms.
+        ///
+        void sleep(const uint32_t ms);
+
+        ///
+        /// Schedules the ``event`` ``delay`` ms from now.
+        ///
+        /// Returns the id of the event, never 0
+        ///
+        event_id schedule(const uint64_t delay, std::function<void()> event);
+
+        ///
+        /// Cancels the event with the ``id``.
+        ///
+        /// Returns ``false`` if the event already fired or was cancelled
+        ///
+        bool cancel(const event_id id);
+
+        ///
+        /// Fires the events scheduled up to ``time`` ms since the epoch, also those the fired events
+        /// schedule, and moves the clock to ``time``.
+        ///
+        /// Returns the number of events fired
+        ///
+        size_t run_until(const uint64_t time);
+
+        ///
+        /// Returns the number of events not yet fired.
+        ///
+        size_t pending() const;
+
+    private:
+        uint64_t m_now;
+        uint64_t m_slept;
+        event_id m_next_id;
+        // the events by their time and id, and the times of the ids
+        std::map<std::pair<uint64_t, event_id>, std::function<void()>> m_events;
+        std::unordered_map<event_id, uint64_t> m_times;
+    };
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "ad.h"
+#include "ec.h"
+
+namespace muvr {
+
+    ///
+    /// The values of one accelerometer sample in mg
+    ///
+    struct axes {
+        int16_t x;
+        int16_t y;
+        int16_t z;
+    };
+
+    ///
+    /// The wire layouts of the accelerometer samples. Every layout is a type whose traits the
+    /// ``encode`` and ``decode`` templates below read at compile time, so that their inner loops
+    /// are generated for each layout, with the bit widths and offsets as constants.
+    ///
+    namespace codec {
+
+        ///
+        /// The 13 bits per axis of ``struct threed_data``: the axes at bits 0, 13 and 26 of
+        /// the 40 bits of a sample, the last bit spare
+        ///
+        struct packed13 {
+            static constexpr uint8_t encoding = AD_ENCODING_PACKED;
+            static constexpr bool fixed_size = true;
+            static constexpr bool scaled = false;
+            static constexpr unsigned axis_bits = 13;
+            static constexpr size_t sample_bits = sizeof(threed_data) * 8;
+            static constexpr size_t bit_offset(const unsigned axis) { return axis * axis_bits; }
+        };
+
+        ///
+        /// The ``Bits`` per axis quantised over ±range mg, packed least significant bit first
+        ///
+        template <unsigned Bits>
+        struct quantised {
+            static_assert(Bits == AD_ENCODING_8_BITS || Bits == AD_ENCODING_10_BITS || Bits == AD_ENCODING_12_BITS,
+                          "the watch quantises to 8, 10 or 12 bits");
+            static constexpr uint8_t encoding = Bits;
+            static constexpr bool fixed_size = true;
+            static constexpr bool scaled = true;
+            static constexpr unsigned axis_bits = Bits;
+            static constexpr size_t sample_bits = 3 * Bits;
+            static constexpr size_t bit_offset(const unsigned axis) { return axis * axis_bits; }
+            static constexpr int32_t levels = (1 << (Bits - 1)) - 1;
+        };
+
+        ///
+        /// The differences of the samples, entropy-coded by ``ec_encode``; the size of a sample varies
+        ///
+        struct delta {
+            static constexpr uint8_t encoding = AD_ENCODING_ENTROPY;
+            static constexpr bool fixed_size = false;
+            static constexpr bool scaled = false;
+        };
+
+        ///
+        /// Returns the payload size in B of ``count`` samples in the fixed-size ``Layout``.
+        ///
+        template <typename Layout>
+        constexpr size_t payload_size(const size_t count) {
+            static_assert(Layout::fixed_size, "the size of the layout depends on the values");
+            return (count * Layout::sample_bits + 7) / 8;
+        }
+
+        namespace detail {
+
+            template <unsigned Bits>
+            inline int16_t read_bits(const uint8_t *payload, const size_t offset) {
+                uint32_t bits = 0;
+                const size_t first = offset / 8;
+                const size_t last = (offset + Bits - 1) / 8;
+                for (size_t i = last + 1; i-- > first;) bits = (bits << 8) | payload[i];
+                bits = (bits >> (offset % 8)) & ((1u << Bits) - 1);
+                // sign-extend the two's complement value
+                return (int16_t)((int32_t)(bits << (32 - Bits)) >> (32 - Bits));
+            }
+
+            template <unsigned Bits>
+            inline void write_bits(uint8_t *payload, const size_t offset, const int16_t value) {
+                uint32_t bits = ((uint32_t)value & ((1u << Bits) - 1)) << (offset % 8);
+                for (size_t i = offset / 8; bits != 0; ++i, bits >>= 8) payload[i] |= (uint8_t)bits;
+            }
+
+            template <typename Layout>
+            inline int16_t quantise(const int16_t value, const uint16_t range) {
+                int32_t v = value > range ? range : (value < -range ? -range : value);
+                return (int16_t)((v * Layout::levels + (v < 0 ? -range : range) / 2) / range);
+            }
+
+            template <typename Layout>
+            inline int16_t restore(const int16_t value, const uint16_t range) {
+                return (int16_t)lround((double)value * range / Layout::levels);
+            }
+
+            template <typename Layout, bool Scaled = Layout::scaled>
+            struct scale {
+                static int16_t to_wire(const int16_t value, const uint16_t) { return value; }
+                static int16_t from_wire(const int16_t value, const uint16_t) { return value; }
+            };
+
+            template <typename Layout>
+            struct scale<Layout, true> {
+                static int16_t to_wire(const int16_t value, const uint16_t range) { return quantise<Layout>(value, range); }
+                static int16_t from_wire(const int16_t value, const uint16_t range) { return restore<Layout>(value, range); }
+            };
+
+        }
+
+        ///
+        /// Encodes the ``samples`` in the ``Layout``; ``range`` is the range in mg of the scaled layouts.
+        ///
+        template <typename Layout>
+        std::vector<uint8_t> encode(const std::vector<axes> &samples, const uint16_t range = 0) {
+            using scale = detail::scale<Layout>;
+            std::vector<uint8_t> payload(payload_size<Layout>(samples.size()), 0);
+            for (size_t i = 0; i < samples.size(); ++i) {
+                const size_t offset = i * Layout::sample_bits;
+                detail::write_bits<Layout::axis_bits>(payload.data(), offset + Layout::bit_offset(0), scale::to_wire(samples[i].x, range));
+                detail::write_bits<Layout::axis_bits>(payload.data(), offset + Layout::bit_offset(1), scale::to_wire(samples[i].y, range));
+                detail::write_bits<Layout::axis_bits>(payload.data(), offset + Layout::bit_offset(2), scale::to_wire(samples[i].z, range));
+            }
+            return payload;
+        }
+
+        ///
+        /// Decodes ``count`` samples from the ``size`` B of ``payload`` in the ``Layout``;
+        /// ``range`` is the range in mg of the scaled layouts.
+        ///
+        /// Throws ``std::invalid_argument`` if the ``payload`` does not hold ``count`` samples
+        ///
+        template <typename Layout>
+        std::vector<axes> decode(const uint8_t *payload, const size_t size, const size_t count, const uint16_t range = 0) {
+            using scale = detail::scale<Layout>;
+            if (size != payload_size<Layout>(count)) throw std::invalid_argument("payload size does not match count");
+            if (Layout::scaled && range == 0) throw std::invalid_argument("zero range");
+
+            std::vector<axes> samples(count);
+            for (size_t i = 0; i < count; ++i) {
+                const size_t offset = i * Layout::sample_bits;
+                samples[i].x = scale::from_wire(detail::read_bits<Layout::axis_bits>(payload, offset + Layout::bit_offset(0)), range);
+                samples[i].y = scale::from_wire(detail::read_bits<Layout::axis_bits>(payload, offset + Layout::bit_offset(1)), range);
+                samples[i].z = scale::from_wire(detail::read_bits<Layout::axis_bits>(payload, offset + Layout::bit_offset(2)), range);
+            }
+            return samples;
+        }
+
+        template <>
+        inline std::vector<uint8_t> encode<delta>(const std::vector<axes> &samples, const uint16_t) {
+            // ec_encode counts the samples and the bytes in uint16_t
+            if (samples.size() > UINT16_MAX) throw std::invalid_argument("too many samples");
+
+            std::vector<threed_data> packed(samples.size());
+            for (size_t i = 0; i < samples.size(); ++i) {
+                packed[i].x_val = samples[i].x;
+                packed[i].y_val = samples[i].y;
+                packed[i].z_val = samples[i].z;
+                packed[i]._ = 0;
+            }
+            // at most 13 + 9 bits per value
+            std::vector<uint8_t> payload(std::min<size_t>((samples.size() * 3 * 22 + 7) / 8 + 1, UINT16_MAX));
+            uint16_t size = ec_encode(packed.data(), (uint16_t)samples.size(), payload.data(), (uint16_t)payload.size());
+            if (size == 0 && !samples.empty()) throw std::invalid_argument("samples do not fit in one payload");
+            payload.resize(size);
+            return payload;
+        }
+
+        template <>
+        inline std::vector<axes> decode<delta>(const uint8_t *payload, const size_t size, const size_t count, const uint16_t) {
+            // ec_decode counts the samples and the bytes in uint16_t
+            if (size > UINT16_MAX || count > UINT16_MAX) throw std::invalid_argument("payload size or count out of range");
+
+            std::vector<threed_data> packed(count);
+            if (ec_decode(payload, (uint16_t)size, packed.data(), (uint16_t)count) != 0) {
+                throw std::invalid_argument("corrupt entropy-coded payload");
+            }
+
+            std::vector<axes> samples(count);
+            for (size_t i = 0; i < count; ++i) samples[i] = axes { packed[i].x_val, packed[i].y_val, packed[i].z_val };
+            return samples;
+        }
+
+    }
+
+}
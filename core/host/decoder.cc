@@ -0,0 +1,87 @@
+#include "decoder.h"
+#include "codec.h"
+#include "am.h"
+#include "ad.h"
+#include "sd.h"
+#include "ck.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace muvr;
+
+///
+/// Decodes the ``count`` samples of the ``payload`` in the ``h.encoding``; the layout is chosen
+/// once per message, the loops over the samples are specialised for it.
+///
+static std::vector<axes> decode_samples(const header &h, const uint8_t *payload, const size_t size, const size_t count) {
+    switch (h.encoding) {
+        case codec::packed13::encoding: return codec::decode<codec::packed13>(payload, size, count);
+        case codec::delta::encoding: return codec::decode<codec::delta>(payload, size, count);
+        case AD_ENCODING_8_BITS: return codec::decode<codec::quantised<8>>(payload, size, count, h.range);
+        case AD_ENCODING_10_BITS: return codec::decode<codec::quantised<10>>(payload, size, count, h.range);
+        case AD_ENCODING_12_BITS: return codec::decode<codec::quantised<12>>(payload, size, count, h.range);
+        default: throw std::invalid_argument("unknown encoding");
+    }
+}
+
+batch muvr::decode(const std::vector<uint8_t> &message) {
+    return decode(message.data(), message.size());
+}
+
+batch muvr::decode(const uint8_t *message, const size_t size) {
+    if (size < sizeof(header)) throw std::invalid_argument("message shorter than header");
+
+    header h;
+    memcpy(&h, message, sizeof(header));
+    if (h.preamble1 != 0x61 || h.preamble2 != 0x65) throw std::invalid_argument("bad preamble");
+    if (size > UINT16_MAX || h.crc != ck_message_crc(message, (uint16_t)size)) throw std::invalid_argument("bad crc");
+
+    batch result;
+    result.type = h.type;
+    result.sequence_number = h.sequence_number;
+    result.samples_per_second = h.samples_per_second;
+    result.sample_interval = h.sample_interval / 256.0;
+
+    if (h.type == SD_TYPE_HEART_RATE || h.type == SD_TYPE_COMPASS) {
+        if (size != sizeof(header) + h.count * sizeof(sensor_data)) {
+            throw std::invalid_argument("payload size does not match count");
+        }
+
+        result.samples.reserve(h.count);
+        const sensor_data *data = reinterpret_cast<const sensor_data *>(message + sizeof(header));
+        for (size_t i = 0; i < h.count; ++i) {
+            result.samples.push_back(sample { h.timestamp * 1000 + data[i].offset, (int16_t)data[i].value, 0, 0 });
+        }
+        return result;
+    }
+
+    if (h.type == AD_TYPE_FEATURES) {
+        if (h.count % AD_FEATURES_VALUES != 0 ||
+            size != sizeof(header) + h.count / AD_FEATURES_VALUES * sizeof(threed_features)) {
+            throw std::invalid_argument("payload size does not match count");
+        }
+
+        result.features.reserve(h.count / AD_FEATURES_VALUES);
+        for (size_t i = 0; i < h.count / AD_FEATURES_VALUES; ++i) {
+            threed_features f;
+            memcpy(&f, message + sizeof(header) + i * sizeof(threed_features), sizeof(threed_features));
+            result.features.push_back(buffer_features {
+                h.timestamp * 1000, f.x_mean, f.y_mean, f.z_mean, f.x_deviation, f.y_deviation, f.z_deviation
+            });
+        }
+        return result;
+    }
+
+    if (h.count % 3 != 0) throw std::invalid_argument("count is not a multiple of 3");
+
+    size_t sample_count = h.count / 3;
+    auto values = decode_samples(h, message + sizeof(header), size - sizeof(header), sample_count);
+
+    result.samples.reserve(sample_count);
+    for (size_t i = 0; i < sample_count; ++i) {
+        double time = h.timestamp * 1000 + i * result.sample_interval;
+        result.samples.push_back(sample { time, values[i].x, values[i].y, values[i].z });
+    }
+
+    return result;
+}
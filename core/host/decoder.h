@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace muvr {
+
+    ///
+    /// One accelerometer sample with its time in ms since the epoch; the samples of the
+    /// single-value streams (the heart rate and the heading) have the value in ``x``
+    ///
+    struct sample {
+        double time;
+        int16_t x;
+        int16_t y;
+        int16_t z;
+    };
+
+    ///
+    /// The ``struct threed_features`` of one buffer of samples with the time of its first sample
+    /// in ms since the epoch
+    ///
+    struct buffer_features {
+        double time;
+        int16_t x_mean;
+        int16_t y_mean;
+        int16_t z_mean;
+        uint16_t x_deviation;
+        uint16_t y_deviation;
+        uint16_t z_deviation;
+    };
+
+    ///
+    /// The decoded ``msg_ad`` message
+    ///
+    struct batch {
+        uint32_t type;
+        uint16_t sequence_number;
+        uint8_t samples_per_second;
+        // the time between two samples in ms
+        double sample_interval;
+        std::vector<sample> samples;
+        // the features of the ``AD_TYPE_FEATURES`` messages, which have no samples
+        std::vector<buffer_features> features;
+    };
+
+    ///
+    /// Decodes the ``message`` (the ``struct header`` followed by the packed ``struct threed_data``
+    /// samples), computing the time of every sample from the header's ``timestamp`` and
+    /// ``sample_interval``. The messages of the sensor streams carry ``struct sensor_data``
+    /// readings with their own times instead, and the ``AD_TYPE_FEATURES`` messages carry the
+    /// ``struct threed_features`` of the buffers that start at the ``timestamp``.
+    ///
+    /// Throws ``std::invalid_argument`` if the ``message`` is not a well-formed sample message,
+    /// or its ``crc`` does not match.
+    ///
+    batch decode(const std::vector<uint8_t> &message);
+
+    ///
+    /// Decodes the ``size`` B of the ``message``, as ``decode`` above.
+    ///
+    batch decode(const uint8_t *message, const size_t size);
+
+}
@@ -0,0 +1,24 @@
+#include "energy.h"
+#include <stdexcept>
+
+using namespace muvr;
+
+workload muvr::measure(const std::vector<std::vector<uint8_t>> &messages, double samples_per_second, double duration) {
+    if (duration <= 0) throw std::invalid_argument("duration must be positive");
+
+    double bytes = 0;
+    for (auto &message : messages) bytes += message.size();
+    return workload { samples_per_second, messages.size() / duration, bytes / duration };
+}
+
+double muvr::current(const energy_model &model, const workload &workload) {
+    return model.idle_current +
+           model.accelerometer_current * workload.samples_per_second +
+           model.sample_charge * workload.samples_per_second +
+           model.message_charge * workload.messages_per_second +
+           model.byte_charge * workload.bytes_per_second;
+}
+
+double muvr::battery_hours(const energy_model &model, const workload &workload) {
+    return model.battery_capacity / current(model, workload);
+}
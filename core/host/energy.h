@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace muvr {
+
+    ///
+    /// The energy costs of the watch. The defaults are rough estimates for a Pebble Time;
+    /// calibrate them against the battery drain of measured sessions.
+    ///
+    struct energy_model {
+        // the battery capacity in mAh
+        double battery_capacity = 150;
+        // the current of the idle watch (display, sleeping MCU, BLE connection) in mA
+        double idle_current = 0.9;
+        // the current of the accelerometer in mA per Hz of sampling rate
+        double accelerometer_current = 0.004;
+        // the CPU charge of capturing and packing one sample in mAs
+        double sample_charge = 0.0005;
+        // the radio charge of one message in mAs
+        double message_charge = 1.2;
+        // the radio charge of one B of message in mAs
+        double byte_charge = 0.004;
+    };
+
+    ///
+    /// The work the watch does in a session
+    ///
+    struct workload {
+        double samples_per_second;
+        double messages_per_second;
+        double bytes_per_second;
+    };
+
+    ///
+    /// Measures the workload of sending the ``messages`` over ``duration`` s while sampling
+    /// at ``samples_per_second``.
+    ///
+    workload measure(const std::vector<std::vector<uint8_t>> &messages, double samples_per_second, double duration);
+
+    ///
+    /// Returns the average current in mA of the ``workload``.
+    ///
+    double current(const energy_model &model, const workload &workload);
+
+    ///
+    /// Returns the hours a full battery lasts running the ``workload``.
+    ///
+    double battery_hours(const energy_model &model, const workload &workload);
+
+}
@@ -0,0 +1,40 @@
+#include "fec.h"
+#include "am.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace muvr;
+
+std::vector<uint8_t> muvr::recover(const std::vector<uint8_t> &parity, const std::vector<std::vector<uint8_t>> &received) {
+    if (parity.size() < sizeof(parity_header)) throw std::invalid_argument("parity shorter than its header");
+
+    parity_header p;
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    if (p.count == 0) throw std::invalid_argument("empty parity group");
+
+    std::vector<uint8_t> lost(parity.begin() + sizeof(parity_header), parity.end());
+    uint16_t size = p.size;
+    std::vector<bool> seen(p.count, false);
+    size_t seen_count = 0;
+    for (auto &message : received) {
+        if (message.size() < sizeof(header)) continue;
+
+        header h;
+        memcpy(&h, message.data(), sizeof(header));
+        // in the group, also when the sequence numbers wrap around
+        const uint16_t index = (uint16_t)(h.sequence_number - p.first);
+        if (index >= p.count || seen[index]) continue;
+        if (message.size() > lost.size()) throw std::invalid_argument("message longer than the parity");
+
+        for (size_t i = 0; i < message.size(); ++i) lost[i] ^= message[i];
+        size ^= (uint16_t)message.size();
+        seen[index] = true;
+        ++seen_count;
+    }
+
+    if (seen_count == p.count) return std::vector<uint8_t>();
+    if (seen_count + 1 < p.count) throw std::invalid_argument("more than one batch lost");
+    if (size > lost.size()) throw std::invalid_argument("inconsistent parity size");
+    lost.resize(size);
+    return lost;
+}
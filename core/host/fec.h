@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace muvr {
+
+    ///
+    /// Reconstructs the one lost sample batch of the group of the ``parity`` message (the
+    /// ``struct parity_header`` followed by the parity) from the ``received`` ``msg_ad`` messages.
+    /// The received messages outside the group are ignored.
+    ///
+    /// Returns the lost message, empty if no batch of the group is lost
+    ///
+    /// Throws ``std::invalid_argument`` if the ``parity`` is malformed or more than one batch is lost
+    ///
+    std::vector<uint8_t> recover(const std::vector<uint8_t> &parity, const std::vector<std::vector<uint8_t>> &received);
+
+}
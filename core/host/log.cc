@@ -0,0 +1,30 @@
+#include "log.h"
+#include "lg.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+using namespace muvr;
+
+#define LG_EVENT_FORMAT(id, format) format,
+static const char *formats[] = { LG_EVENTS(LG_EVENT_FORMAT) };
+#undef LG_EVENT_FORMAT
+
+std::vector<log_entry> muvr::format_log(const uint8_t *records, const size_t size) {
+    if (size % sizeof(lg_record) != 0) throw std::invalid_argument("size is not a multiple of the record size");
+
+    std::vector<log_entry> result;
+    for (size_t offset = 0; offset < size; offset += sizeof(lg_record)) {
+        lg_record record;
+        memcpy(&record, records + offset, sizeof(lg_record));
+
+        char text[128];
+        if (record.event < LG_EVENT_COUNT) {
+            snprintf(text, sizeof(text), formats[record.event], (int)record.args[0], (int)record.args[1], (int)record.args[2]);
+        } else {
+            snprintf(text, sizeof(text), "unknown event %u: %d %d %d", record.event, (int)record.args[0], (int)record.args[1], (int)record.args[2]);
+        }
+        result.push_back(log_entry { (double)record.seconds * 1000 + record.ms, record.event, text });
+    }
+    return result;
+}
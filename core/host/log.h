@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace muvr {
+
+    ///
+    /// One event of the watch's log, formatted
+    ///
+    struct log_entry {
+        // the watch time in ms since the epoch
+        double time;
+        uint16_t event;
+        std::string text;
+    };
+
+    ///
+    /// Formats the ``struct lg_record``s in the ``size`` B of ``records``, as read by ``lg_read``
+    /// or sent in the ``msg_log`` message, with the formats of their events in lg.h.
+    ///
+    /// Throws ``std::invalid_argument`` if the ``size`` is not a multiple of the record size
+    ///
+    std::vector<log_entry> format_log(const uint8_t *records, const size_t size);
+
+}
@@ -0,0 +1,218 @@
+#include "pipeline.h"
+#include "codec.h"
+#include "am.h"
+#include "ad.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace muvr;
+
+///
+/// The waiting of a stage with nothing to do: it spins for a while, as the next item is usually
+/// close, then yields its core, then naps.
+///
+class idle {
+public:
+    void wait() {
+        if (++m_rounds < 64) return;
+        if (m_rounds < 1024) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    void reset() { m_rounds = 0; }
+
+private:
+    unsigned m_rounds = 0;
+};
+
+///
+/// Moves all ``count`` ``items`` to the ``ring``, waiting while it is full.
+///
+template <typename T, size_t Capacity>
+static void push_all(spsc_ring<T, Capacity> &ring, T *items, const size_t count) {
+    idle idle;
+    for (size_t pushed = 0; pushed < count; idle.wait()) pushed += ring.push(items + pushed, count - pushed);
+}
+
+///
+/// Gives the items of the ``ring`` to ``process`` in batches of up to ``batch_size`` until
+/// its producer is ``done`` and the ring is empty.
+///
+template <typename T, size_t Capacity, typename F>
+static void drain(spsc_ring<T, Capacity> &ring, const std::atomic<bool> &done, const size_t batch_size, F process) {
+    std::vector<T> batch(batch_size);
+    idle idle;
+    while (true) {
+        size_t n = ring.pop(batch.data(), batch.size());
+        if (n == 0) {
+            // the producer pushed its last item before it set done
+            if (!done.load(std::memory_order_acquire)) { idle.wait(); continue; }
+            n = ring.pop(batch.data(), batch.size());
+            if (n == 0) return;
+        }
+        idle.reset();
+        process(batch.data(), n);
+    }
+}
+
+///
+/// Returns ``true`` if the ``message`` has the header of an accelerometer message whose payload
+/// holds the samples the header counts; the entropy-coded payloads are checked by the decoder.
+///
+static bool well_formed(const message &message) {
+    header h;
+    memcpy(&h, message.bytes.data(), sizeof(header));
+    if (h.preamble1 != 0x61 || h.preamble2 != 0x65 || h.count % 3 != 0) return false;
+
+    const size_t size = message.bytes.size() - sizeof(header);
+    const size_t count = h.count / 3;
+    switch (h.encoding) {
+        case AD_ENCODING_PACKED: return size == codec::payload_size<codec::packed13>(count);
+        case AD_ENCODING_ENTROPY: return true;
+        case AD_ENCODING_8_BITS: return size == codec::payload_size<codec::quantised<8>>(count);
+        case AD_ENCODING_10_BITS: return size == codec::payload_size<codec::quantised<10>>(count);
+        case AD_ENCODING_12_BITS: return size == codec::payload_size<codec::quantised<12>>(count);
+        default: return false;
+    }
+}
+
+activity muvr::classify(const std::vector<sample> &samples, const pipeline_config &config) {
+    if (samples.empty()) return activity::not_moving;
+
+    double mean[3] = { 0, 0, 0 };
+    for (auto &s : samples) {
+        mean[0] += s.x;
+        mean[1] += s.y;
+        mean[2] += s.z;
+    }
+    for (auto &m : mean) m /= samples.size();
+
+    double deviation = 0;
+    for (auto &s : samples) deviation += std::abs(s.x - mean[0]) + std::abs(s.y - mean[1]) + std::abs(s.z - mean[2]);
+    deviation /= samples.size();
+
+    if (deviation >= config.exercising_threshold) return activity::exercising;
+    if (deviation >= config.moving_threshold) return activity::moving;
+    return activity::not_moving;
+}
+
+pipeline::pipeline(const pipeline_config &config, std::function<void(const classification &)> sink):
+        m_config(config), m_sink(sink),
+        m_received(new spsc_ring<message, ring_capacity>()), m_framed(new spsc_ring<message, ring_capacity>()),
+        m_decoded(new spsc_ring<decoded, ring_capacity>()), m_windows(new spsc_ring<window, ring_capacity>()) {
+    if (config.window_size == 0 || config.window_step == 0 || config.batch_size == 0) {
+        throw std::invalid_argument("zero window or batch");
+    }
+    m_stages.emplace_back(&pipeline::frame, this);
+    m_stages.emplace_back(&pipeline::unpack, this);
+    m_stages.emplace_back(&pipeline::cut, this);
+    m_stages.emplace_back(&pipeline::classify, this);
+}
+
+pipeline::~pipeline() {
+    close();
+}
+
+void pipeline::submit(message *messages, const size_t count) {
+    push_all(*m_received, messages, count);
+}
+
+void pipeline::submit(message &&message) {
+    submit(&message, 1);
+}
+
+bool pipeline::try_submit(message &message) {
+    return m_received->push(&message, 1) == 1;
+}
+
+void pipeline::close() {
+    m_received_done.store(true, std::memory_order_release);
+    for (auto &stage : m_stages) {
+        if (stage.joinable()) stage.join();
+    }
+}
+
+pipeline_statistics pipeline::statistics() const {
+    pipeline_statistics result;
+    result.messages = m_messages.load(std::memory_order_relaxed);
+    result.malformed = m_malformed.load(std::memory_order_relaxed);
+    result.skipped = m_skipped.load(std::memory_order_relaxed);
+    result.samples = m_samples.load(std::memory_order_relaxed);
+    result.windows = m_window_count.load(std::memory_order_relaxed);
+    return result;
+}
+
+void pipeline::frame() {
+    std::vector<message> framed;
+    framed.reserve(m_config.batch_size);
+    drain(*m_received, m_received_done, m_config.batch_size, [this, &framed](message *messages, const size_t count) {
+        uint64_t malformed = 0, skipped = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (messages[i].bytes.size() < sizeof(header)) { ++malformed; continue; }
+            uint32_t type;
+            memcpy(&type, messages[i].bytes.data() + offsetof(header, type), sizeof(type));
+            if (type != AD_TYPE_ACCELEROMETER) { ++skipped; continue; }
+            if (!well_formed(messages[i])) { ++malformed; continue; }
+            framed.push_back(std::move(messages[i]));
+        }
+        m_messages.fetch_add(count, std::memory_order_relaxed);
+        m_malformed.fetch_add(malformed, std::memory_order_relaxed);
+        m_skipped.fetch_add(skipped, std::memory_order_relaxed);
+        push_all(*m_framed, framed.data(), framed.size());
+        framed.clear();
+    });
+    m_framed_done.store(true, std::memory_order_release);
+}
+
+void pipeline::unpack() {
+    std::vector<decoded> unpacked;
+    unpacked.reserve(m_config.batch_size);
+    drain(*m_framed, m_framed_done, m_config.batch_size, [this, &unpacked](message *messages, const size_t count) {
+        uint64_t malformed = 0, samples = 0;
+        for (size_t i = 0; i < count; ++i) {
+            try {
+                unpacked.push_back(decoded { messages[i].watch, decode(messages[i].bytes.data(), messages[i].bytes.size()) });
+                samples += unpacked.back().samples.samples.size();
+            } catch (const std::invalid_argument &) {
+                ++malformed;
+            }
+        }
+        m_malformed.fetch_add(malformed, std::memory_order_relaxed);
+        m_samples.fetch_add(samples, std::memory_order_relaxed);
+        push_all(*m_decoded, unpacked.data(), unpacked.size());
+        unpacked.clear();
+    });
+    m_decoded_done.store(true, std::memory_order_release);
+}
+
+void pipeline::cut() {
+    // the samples of every watch not yet in a window
+    std::unordered_map<uint32_t, std::vector<sample>> pending;
+    std::vector<window> windows;
+    drain(*m_decoded, m_decoded_done, m_config.batch_size, [this, &pending, &windows](decoded *batches, const size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            auto &samples = pending[batches[i].watch];
+            auto &received = batches[i].samples.samples;
+            samples.insert(samples.end(), received.begin(), received.end());
+            while (samples.size() >= m_config.window_size) {
+                windows.push_back(window { batches[i].watch, std::vector<sample>(samples.begin(), samples.begin() + m_config.window_size) });
+                samples.erase(samples.begin(), samples.begin() + std::min(m_config.window_step, samples.size()));
+            }
+        }
+        m_window_count.fetch_add(windows.size(), std::memory_order_relaxed);
+        push_all(*m_windows, windows.data(), windows.size());
+        windows.clear();
+    });
+    m_windows_done.store(true, std::memory_order_release);
+}
+
+void pipeline::classify() {
+    drain(*m_windows, m_windows_done, m_config.batch_size, [this](window *windows, const size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            m_sink(classification { windows[i].watch, windows[i].samples.front().time, muvr::classify(windows[i].samples, m_config) });
+        }
+    });
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "decoder.h"
+#include "spsc.h"
+
+namespace muvr {
+
+    ///
+    /// What the movement in a window looks like
+    ///
+    enum class activity : uint8_t {
+        not_moving,
+        moving,
+        exercising
+    };
+
+    ///
+    /// The ``msg_ad`` message received from the ``watch``
+    ///
+    struct message {
+        uint32_t watch;
+        std::vector<uint8_t> bytes;
+    };
+
+    ///
+    /// The accelerometer samples of one watch in consecutive messages
+    ///
+    struct window {
+        uint32_t watch;
+        std::vector<sample> samples;
+    };
+
+    ///
+    /// The ``activity`` of the window of the ``watch`` that starts at ``time`` ms since the epoch
+    ///
+    struct classification {
+        uint32_t watch;
+        double time;
+        muvr::activity activity;
+    };
+
+    struct pipeline_config {
+        // the samples in a window, and the samples between the starts of two windows
+        size_t window_size = 100;
+        size_t window_step = 50;
+        // the sum of the mean absolute deviations of the axes in mg from which a window is moving,
+        // the watch's gating threshold, and from which it is exercising
+        uint32_t moving_threshold = 60;
+        uint32_t exercising_threshold = 600;
+        // the most items a stage takes from its ring at once
+        size_t batch_size = 64;
+    };
+
+    ///
+    /// What went through the pipeline so far
+    ///
+    struct pipeline_statistics {
+        uint64_t messages = 0;
+        // the messages with a bad header or payload, and those of the other streams
+        uint64_t malformed = 0;
+        uint64_t skipped = 0;
+        uint64_t samples = 0;
+        uint64_t windows = 0;
+    };
+
+    ///
+    /// Classifies the ``samples`` by the sum of the mean absolute deviations of their axes.
+    ///
+    activity classify(const std::vector<sample> &samples, const pipeline_config &config);
+
+    ///
+    /// The host ingestion of the ``msg_ad`` messages, in four stages on their own threads:
+    /// - frame: checks the header of every message, dropping the malformed ones and those of the
+    ///   streams other than the accelerometer
+    /// - unpack: decodes the samples of the message
+    /// - window: cuts the samples of every watch into overlapping windows
+    /// - classify: classifies the windows and gives the classifications to the ``sink``
+    ///
+    /// The stages are connected by ``spsc_ring``s; every stage moves up to ``batch_size`` items
+    /// from its ring at once. A stage with nothing to do spins, then yields, then naps, so an idle
+    /// pipeline does not keep its cores busy.
+    ///
+    /// ``submit`` is called from one thread only; the ``sink`` is called on the classify thread.
+    ///
+    class pipeline {
+    public:
+        pipeline(const pipeline_config &config, std::function<void(const classification &)> sink);
+
+        ///
+        /// Closes the pipeline and waits until it is drained.
+        ///
+        ~pipeline();
+
+        pipeline(const pipeline &) = delete;
+        pipeline &operator=(const pipeline &) = delete;
+
+        ///
+        /// Moves the ``count`` ``messages`` to the pipeline, waiting while it is full.
+        ///
+        void submit(message *messages, const size_t count);
+
+        void submit(message &&message);
+
+        ///
+        /// Moves the ``message`` to the pipeline if it has room.
+        ///
+        /// Returns ``false`` if the pipeline is full; the ``message`` is kept
+        ///
+        bool try_submit(message &message);
+
+        ///
+        /// Waits until every submitted message went through the pipeline and stops the stages;
+        /// the pipeline accepts no more messages.
+        ///
+        void close();
+
+        ///
+        /// Returns what went through the pipeline so far.
+        ///
+        pipeline_statistics statistics() const;
+
+    private:
+        static constexpr size_t ring_capacity = 1024;
+
+        struct decoded {
+            uint32_t watch;
+            batch samples;
+        };
+
+        void frame();
+        void unpack();
+        void cut();
+        void classify();
+
+        pipeline_config m_config;
+        std::function<void(const classification &)> m_sink;
+
+        std::unique_ptr<spsc_ring<message, ring_capacity>> m_received;
+        std::unique_ptr<spsc_ring<message, ring_capacity>> m_framed;
+        std::unique_ptr<spsc_ring<decoded, ring_capacity>> m_decoded;
+        std::unique_ptr<spsc_ring<window, ring_capacity>> m_windows;
+        // set by the producer of every ring once it pushed its last item
+        std::atomic<bool> m_received_done { false };
+        std::atomic<bool> m_framed_done { false };
+        std::atomic<bool> m_decoded_done { false };
+        std::atomic<bool> m_windows_done { false };
+
+        std::atomic<uint64_t> m_messages { 0 };
+        std::atomic<uint64_t> m_malformed { 0 };
+        std::atomic<uint64_t> m_skipped { 0 };
+        std::atomic<uint64_t> m_samples { 0 };
+        std::atomic<uint64_t> m_window_count { 0 };
+
+        std::vector<std::thread> m_stages;
+    };
+
+}
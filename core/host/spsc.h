@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace muvr {
+
+    ///
+    /// A lock-free ring of ``Capacity`` items between exactly one producer thread and one consumer
+    /// thread. The producer owns ``m_tail``, the consumer ``m_head``; each publishes its index with
+    /// release and reads the other's with acquire, and only when its cached copy says the ring is
+    /// full (or empty). The indices are on separate cache lines, so the two threads do not share
+    /// a line while the ring is neither full nor empty.
+    ///
+    template <typename T, size_t Capacity>
+    class spsc_ring {
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "the capacity is a power of two");
+        static constexpr size_t cache_line = 64;
+        static constexpr size_t mask = Capacity - 1;
+
+    public:
+        spsc_ring(): m_items(Capacity) { }
+
+        spsc_ring(const spsc_ring &) = delete;
+        spsc_ring &operator=(const spsc_ring &) = delete;
+
+        ///
+        /// Moves as many of the ``count`` ``items`` as fit to the ring, in order; producer only.
+        ///
+        /// Returns the number of items moved
+        ///
+        size_t push(T *items, const size_t count) {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (Capacity - (tail - m_head_cache) < count) m_head_cache = m_head.load(std::memory_order_acquire);
+            const size_t n = std::min(count, Capacity - (tail - m_head_cache));
+            for (size_t i = 0; i < n; ++i) m_items[(tail + i) & mask] = std::move(items[i]);
+            m_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        ///
+        /// Moves up to ``count`` of the oldest items from the ring to ``items``; consumer only.
+        ///
+        /// Returns the number of items moved
+        ///
+        size_t pop(T *items, const size_t count) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (m_tail_cache - head < count) m_tail_cache = m_tail.load(std::memory_order_acquire);
+            const size_t n = std::min(count, m_tail_cache - head);
+            for (size_t i = 0; i < n; ++i) items[i] = std::move(m_items[(head + i) & mask]);
+            m_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        bool push(T &&item) { return push(&item, 1) == 1; }
+        bool pop(T &item) { return pop(&item, 1) == 1; }
+
+        ///
+        /// Returns the number of items in the ring; exact only on a quiet ring.
+        ///
+        size_t size() const {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        static constexpr size_t capacity() { return Capacity; }
+
+    private:
+        std::vector<T> m_items;
+        // the consumer's line: the next item to pop, and the last tail it read
+        std::atomic<size_t> m_head { 0 };
+        size_t m_tail_cache = 0;
+        char m_consumer_padding[cache_line];
+        // the producer's line: the next slot to push to, and the last head it read
+        std::atomic<size_t> m_tail { 0 };
+        size_t m_head_cache = 0;
+        char m_producer_padding[cache_line];
+    };
+
+}
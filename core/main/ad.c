@@ -1,92 +1,572 @@
 #include <pebble.h>
+#include <stdlib.h>
 #include "ad.h"
-
-#define TIME_NAN 0
+#include "mm.h"
+#include "lg.h"
+#include "sg.h"
 
 /**
- * Context that holds the current callback and samples_per_second. It is used in the accelerometer
- * callback to calculate the G forces and to push the packed sample buffer to the callback.
+ * Context of one pipeline that holds its sink and samples_per_second. It is used in the accelerometer
+ * callback to calculate the G forces and to push the packed sample buffer to the sink.
  */
-static struct {
-    // the callback function
-    message_callback_t callback;
+struct ad_context_t {
+    // the sink of the submitted buffers
+    struct message_sink sink;
+    // taken by ad_open()
+    bool open;
     // the samples_per_second
     uint8_t samples_per_second;
+    // the pipeline keeps every decimation-th sample of the accelerometer service; phase counts
+    // the service samples since the last kept one
+    uint8_t decimation;
+    uint8_t phase;
+    // the AD_MODE_* of the submitted buffers
+    uint8_t mode;
+    // the AD_ENCODING_* of the submitted samples and the range of the quantised encodings
+    uint8_t encoding;
+    uint16_t range;
     // the buffer
     uint8_t buffer[AD_BUFFER_SIZE];
     // the maximum time
     uint16_t maximum_time;
     // the position in the buffer
     uint16_t buffer_position;
-    // the start time
+    // the time of the first sample in the buffer
     uint64_t start_time;
-} ad_context;
+    // the time of the first sample of the last update
+    uint64_t last_time;
+    // the index in the buffer of the first sample of the last update
+    uint16_t last_index;
+    // the expected time of the first sample of the next update
+    uint64_t next_time;
+    // the number of samples that could not be submitted
+    uint32_t dropped_samples;
+    // the wake on motion is on, and the pipeline waits for the movement at AD_STANDBY_RATE
+    bool standby;
+    bool idle;
+    // the time in ms of the submitted samples without movement since the last movement
+    uint32_t quiet_time;
+    // the last samples of the standby: the slot of the next one, their number, and the time of the newest
+    struct threed_data preroll[AD_PREROLL_LENGTH];
+    uint8_t preroll_next;
+    uint8_t preroll_count;
+    uint64_t preroll_time;
+};
+
+_Static_assert(sizeof(struct ad_context_t) <= MM_AD_BUDGET, "ad context exceeds its budget");
+_Static_assert(AD_PREROLL_LENGTH * sizeof(struct threed_data) <= AD_BUFFER_SIZE, "the pre-roll does not fit in the buffer");
+
+// the pipelines, each reserved in the arena by the first ad_open() that needs it
+static struct ad_context_t *ad_pool[MM_AD_INSTANCES];
+// the sampling rate of the accelerometer service, 0 when no pipeline is running
+static uint8_t ad_service_rate;
+// the synthetic signal that replaces the samples of the accelerometer service
+static struct sg_generator ad_generator;
 
 #define SIGNED_12_MAX(x) (int16_t)((x) > 4095 ? 4095 : ((x) < -4095 ? -4095 : (x)))
 
+static bool ad_running(const struct ad_context_t *ad) {
+    return ad != NULL && ad->sink.callback != NULL;
+}
+
 /**
- * Handle the samples arriving.
+ * The rate the pipeline samples at: ``AD_STANDBY_RATE`` in the standby, the configured ``samples_per_second`` otherwise.
  */
-static void ad_raw_accel_data_handler(AccelRawData *data, uint32_t num_samples, uint64_t timestamp) {
-    if (num_samples != AD_NUM_SAMPLES) return /* FAIL */;
-    size_t len = sizeof(struct threed_data) * num_samples;
-    // pack
-    struct threed_data *ad = (struct threed_data *)(ad_context.buffer + ad_context.buffer_position);
-    for (unsigned int i = 0; i < num_samples; ++i) {
-        
-#ifndef TEST_WITH_SINES
-        ad[i].x_val = SIGNED_12_MAX(data[i].x);
-        ad[i].y_val = SIGNED_12_MAX(data[i].y);
-        ad[i].z_val = SIGNED_12_MAX(data[i].z);
-#else
-        ad[i].x_val = sin_lookup((timestamp * 300) % TRIG_MAX_ANGLE) >> 6; // SIGNED_12_MAX(data[i].x);
-        ad[i].y_val = sin_lookup((timestamp * 300) % TRIG_MAX_ANGLE) >> 6; // SIGNED_12_MAX(data[i].y);
-        ad[i].z_val = cos_lookup((timestamp * 300) % TRIG_MAX_ANGLE) >> 6; // SIGNED_12_MAX(data[i].z);
-#endif
-        
-    }
-    ad_context.buffer_position += len;
-
-    bool submit = false;
-    if (ad_context.start_time != TIME_NAN) {
-        if (timestamp - ad_context.start_time >= ad_context.maximum_time) {
-            submit = true;
+static uint8_t ad_rate(const struct ad_context_t *ad) {
+    return ad->idle ? AD_STANDBY_RATE : ad->samples_per_second;
+}
+
+/**
+ * The sample interval at the ``ad_rate(...)`` in 1/256 ms.
+ */
+static uint16_t ad_nominal_interval(const struct ad_context_t *ad) {
+    return (uint16_t)((1000 << 8) / ad_rate(ad));
+}
+
+/**
+ * The sample interval of the samples in the buffer in 1/256 ms, measured from the timestamps
+ * of the updates in the buffer. This removes the firmware jitter and the drift of the
+ * accelerometer clock from the individual updates.
+ */
+static uint16_t ad_sample_interval(const struct ad_context_t *ad) {
+    uint16_t nominal = ad_nominal_interval(ad);
+    if (ad->last_index == 0 || ad->last_time <= ad->start_time) return nominal;
+
+    uint32_t measured = (uint32_t)(((ad->last_time - ad->start_time) << 8) / ad->last_index);
+    // the timestamps make no sense; this cannot be explained by jitter
+    if (measured < nominal / 2 || measured > nominal * 2) return nominal;
+    return (uint16_t)measured;
+}
+
+/**
+ * Computes the ``features`` of the ``count`` ``samples``.
+ */
+static void ad_features(const struct threed_data *samples, const uint16_t count, struct threed_features *features) {
+    int32_t x = 0, y = 0, z = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        x += samples[i].x_val;
+        y += samples[i].y_val;
+        z += samples[i].z_val;
+    }
+    features->x_mean = (int16_t)(x / count);
+    features->y_mean = (int16_t)(y / count);
+    features->z_mean = (int16_t)(z / count);
+
+    uint32_t dx = 0, dy = 0, dz = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        dx += abs(samples[i].x_val - features->x_mean);
+        dy += abs(samples[i].y_val - features->y_mean);
+        dz += abs(samples[i].z_val - features->z_mean);
+    }
+    features->x_deviation = (uint16_t)(dx / count);
+    features->y_deviation = (uint16_t)(dy / count);
+    features->z_deviation = (uint16_t)(dz / count);
+}
+
+/**
+ * Quantises the ``count`` samples in the buffer in place to ``encoding`` bits per axis over
+ * ±``range``, packing the values least significant bit first. A packed sample is never longer
+ * than a ``struct threed_data``, so the writes stay behind the samples still to be read.
+ * Returns the packed size in B.
+ */
+static uint16_t ad_quantise(struct ad_context_t *ad, const uint16_t count) {
+    const struct threed_data *samples = (const struct threed_data *)ad->buffer;
+    uint8_t *packed = ad->buffer;
+    const uint8_t bits = ad->encoding;
+    const int32_t range = ad->range;
+    const int32_t levels = (1 << (bits - 1)) - 1;
+    const uint32_t mask = (1u << bits) - 1;
+
+    uint32_t accumulator = 0;
+    uint8_t accumulated = 0;
+    uint16_t size = 0;
+    for (uint16_t i = 0; i < count; ++i) {
+        int32_t values[3] = { samples[i].x_val, samples[i].y_val, samples[i].z_val };
+        for (int j = 0; j < 3; ++j) {
+            int32_t v = values[j] > range ? range : (values[j] < -range ? -range : values[j]);
+            // rounded to the nearest level
+            int32_t q = (v * levels + (v < 0 ? -range : range) / 2) / range;
+            accumulator |= ((uint32_t)q & mask) << accumulated;
+            accumulated += bits;
+            while (accumulated >= 8) {
+                packed[size++] = (uint8_t)accumulator;
+                accumulator >>= 8;
+                accumulated -= 8;
+            }
         }
-    } else {
-        ad_context.start_time = timestamp;
     }
-    if (ad_context.buffer_position == AD_BUFFER_SIZE) {
-        submit = true;
+    if (accumulated > 0) packed[size++] = (uint8_t)accumulator;
+
+    return size;
+}
+
+/**
+ * Counts the ``count`` samples that the sink could not keep.
+ */
+static void ad_dropped(struct ad_context_t *ad, const uint16_t count) {
+    ad->dropped_samples += count;
+    LG_DEBUG(LG_AD_NOT_SUBMITTED, count);
+}
+
+/**
+ * Submit the ``count`` samples in the buffer to the sink in the configured encoding.
+ */
+static void ad_submit_samples(struct ad_context_t *ad, const uint16_t count, const double timestamp_in_seconds, const uint16_t sample_interval) {
+    uint16_t size = count * sizeof(struct threed_data);
+    if (ad->encoding >= AD_ENCODING_8_BITS) size = ad_quantise(ad, count);
+    if (!ad->sink.callback(ad->sink.context, ad->buffer, size, timestamp_in_seconds, sample_interval)) ad_dropped(ad, count);
+}
+
+/**
+ * Submit the packed samples to the sink with the time of the first sample and the sample interval.
+ * Returns the submitted sample interval.
+ */
+static uint16_t ad_submit(struct ad_context_t *ad) {
+    uint16_t sample_interval = ad_sample_interval(ad);
+    uint16_t count = ad->buffer_position / sizeof(struct threed_data);
+    double timestamp_in_seconds = (double)ad->start_time / 1000;
+    ad->buffer_position = 0;
+
+    if (ad->mode == AD_MODE_RAW && !ad->standby) {
+        ad_submit_samples(ad, count, timestamp_in_seconds, sample_interval);
+        return sample_interval;
+    }
+
+    struct threed_features features;
+    ad_features((const struct threed_data *)ad->buffer, count, &features);
+    bool moving = features.x_deviation + features.y_deviation + features.z_deviation >= AD_MOTION_THRESHOLD;
+    if (ad->standby) ad->quiet_time = moving ? 0 : ad->quiet_time + ((count * sample_interval) >> 8);
+    if (ad->mode == AD_MODE_FEATURES) {
+        if (!ad->sink.callback(ad->sink.context, (uint8_t *)&features, sizeof(struct threed_features), timestamp_in_seconds, sample_interval)) {
+            ad_dropped(ad, count);
+        }
+    } else if (ad->mode == AD_MODE_RAW || moving) {
+        ad_submit_samples(ad, count, timestamp_in_seconds, sample_interval);
+    }
+    return sample_interval;
+}
+
+/**
+ * Checks whether the update at ``timestamp`` does not continue the samples in the buffer,
+ * because the firmware skipped samples or the clock jumped.
+ */
+static bool ad_is_gap(const struct ad_context_t *ad, uint64_t timestamp) {
+    uint64_t tolerance = ad_nominal_interval(ad) >> 8;
+    return timestamp > ad->next_time + tolerance || timestamp + tolerance < ad->next_time;
+}
+
+/**
+ * Checks that the accelerometer service can sample at ``frequency``.
+ */
+static bool ad_valid_frequency(const uint8_t frequency) {
+    switch (frequency) {
+        case ACCEL_SAMPLING_10HZ:
+        case ACCEL_SAMPLING_25HZ:
+        case ACCEL_SAMPLING_50HZ:
+        case ACCEL_SAMPLING_100HZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Packs the ``count`` samples of ``data`` that are ``stride`` samples apart; the samples that do not
+ * fit in the remaining space of the buffer go to the next buffer. The ``timestamp`` is the time of
+ * the first sample.
+ */
+static void ad_pack(struct ad_context_t *ad, const AccelRawData *data, const uint8_t stride, const uint32_t count, const uint64_t timestamp) {
+    if (count == 0) return;
+
+    // a gap ends the buffer, so that all samples in one buffer are evenly spaced
+    if (ad->buffer_position > 0 && ad_is_gap(ad, timestamp)) ad_submit(ad);
+
+    if (ad->buffer_position == 0) {
+        ad->start_time = timestamp;
+        ad->last_index = 0;
+    } else {
+        ad->last_index = ad->buffer_position / sizeof(struct threed_data);
     }
+    ad->last_time = timestamp;
+    ad->next_time = timestamp + ((count * ad_nominal_interval(ad)) >> 8);
 
-    if (submit) {
-        uint16_t duration = (uint16_t)(timestamp - ad_context.start_time);
-        if (ad_context.callback != NULL) {
-            double timestamp_in_seconds = (double)(timestamp / 1000);
-            ad_context.callback(ad_context.buffer, ad_context.buffer_position, timestamp_in_seconds, duration);
-        } else {
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "Not submitting %d samples, %d reported duration", ad_context.buffer_position / sizeof(struct threed_data), duration);
+    uint32_t i = 0;
+    while (i < count) {
+        uint32_t space = (AD_BUFFER_SIZE - ad->buffer_position) / sizeof(struct threed_data);
+        uint32_t n = count - i < space ? count - i : space;
+        // pack
+        struct threed_data *packed = (struct threed_data *)(ad->buffer + ad->buffer_position);
+        for (unsigned int j = 0; j < n; ++j) {
+            const AccelRawData *sample = &data[(i + j) * stride];
+            packed[j].x_val = SIGNED_12_MAX(sample->x);
+            packed[j].y_val = SIGNED_12_MAX(sample->y);
+            packed[j].z_val = SIGNED_12_MAX(sample->z);
         }
-        ad_context.buffer_position = 0;
-        ad_context.start_time = timestamp;
+        ad->buffer_position += n * sizeof(struct threed_data);
+        i += n;
+
+        // the buffer is full, but there may be more samples to pack
+        if (AD_BUFFER_SIZE - ad->buffer_position < sizeof(struct threed_data)) {
+            uint16_t sample_interval = ad_submit(ad);
+            ad->start_time = timestamp + ((i * sample_interval) >> 8);
+            ad->last_time = ad->start_time;
+            ad->last_index = 0;
+        }
+    }
+
+    if (ad->buffer_position > 0 && ad->next_time - ad->start_time >= ad->maximum_time) {
+        ad_submit(ad);
+    }
+}
+
+/**
+ * Puts the recording in the standby, submitting the samples captured so far.
+ */
+static void ad_sleep(struct ad_context_t *ad) {
+    if (ad->buffer_position > 0) ad_submit(ad);
+    ad->idle = true;
+    ad->quiet_time = 0;
+    ad->preroll_next = 0;
+    ad->preroll_count = 0;
+    LG_DEBUG(LG_AD_STANDBY, 1);
+}
+
+/**
+ * Ends the standby at the first movement: the samples of the pre-roll, the oldest first, are
+ * submitted at ``AD_STANDBY_RATE`` ahead of the samples at the recording's own frequency.
+ */
+static void ad_wake(struct ad_context_t *ad) {
+    struct threed_data *packed = (struct threed_data *)ad->buffer;
+    uint8_t first = (uint8_t)((ad->preroll_next + AD_PREROLL_LENGTH - ad->preroll_count) % AD_PREROLL_LENGTH);
+    for (uint8_t i = 0; i < ad->preroll_count; ++i) packed[i] = ad->preroll[(first + i) % AD_PREROLL_LENGTH];
+    ad->buffer_position = ad->preroll_count * sizeof(struct threed_data);
+    ad->start_time = ad->preroll_time - (ad->preroll_count - 1) * 1000 / AD_STANDBY_RATE;
+    ad->last_time = ad->start_time;
+    ad->last_index = 0;
+    // still in the standby, so that the buffer goes with the standby's sample interval
+    ad_submit(ad);
+
+    ad->idle = false;
+    ad->quiet_time = 0;
+    ad->preroll_count = 0;
+    LG_DEBUG(LG_AD_STANDBY, 0);
+}
+
+/**
+ * Keeps the ``count`` samples of ``data`` that are ``stride`` samples apart in the pre-roll, and
+ * wakes the recording if they move. The ``timestamp`` is the time of the first sample.
+ * Returns ``true`` if the recording woke.
+ */
+static bool ad_watch(struct ad_context_t *ad, const AccelRawData *data, const uint8_t stride, const uint32_t count, const uint64_t timestamp) {
+    if (count == 0) return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const AccelRawData *sample = &data[i * stride];
+        struct threed_data *kept = &ad->preroll[ad->preroll_next];
+        kept->x_val = SIGNED_12_MAX(sample->x);
+        kept->y_val = SIGNED_12_MAX(sample->y);
+        kept->z_val = SIGNED_12_MAX(sample->z);
+        ad->preroll_next = (uint8_t)((ad->preroll_next + 1) % AD_PREROLL_LENGTH);
+        if (ad->preroll_count < AD_PREROLL_LENGTH) ++ad->preroll_count;
+    }
+    ad->preroll_time = timestamp + (count - 1) * 1000 / AD_STANDBY_RATE;
+
+    struct threed_features features;
+    ad_features(ad->preroll, ad->preroll_count, &features);
+    if (features.x_deviation + features.y_deviation + features.z_deviation < AD_MOTION_THRESHOLD) return false;
+
+    ad_wake(ad);
+    return true;
+}
+
+/**
+ * Takes the ``count`` samples of ``data`` that are ``stride`` samples apart, packing them or keeping
+ * them in the pre-roll of the standby. The ``timestamp`` is the time of the first sample.
+ * Returns ``true`` if the recording went in or out of the standby, changing its rate.
+ */
+static bool ad_take(struct ad_context_t *ad, const AccelRawData *data, const uint8_t stride, const uint32_t count, const uint64_t timestamp) {
+    if (ad->idle) return ad_watch(ad, data, stride, count, timestamp);
+
+    ad_pack(ad, data, stride, count, timestamp);
+    if (!ad->standby || ad->quiet_time < AD_STANDBY_AFTER || ad->samples_per_second % AD_STANDBY_RATE != 0) return false;
+
+    ad_sleep(ad);
+    return true;
+}
+
+/**
+ * Returns the rate of the accelerometer service for the running pipelines: the highest of their
+ * rates, or of their configured rates if the standby rate is not a whole fraction of it.
+ */
+static uint8_t ad_running_rate(void) {
+    uint8_t rate = 0, configured = 0;
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        if (!ad_running(ad_pool[p])) continue;
+        if (ad_rate(ad_pool[p]) > rate) rate = ad_rate(ad_pool[p]);
+        if (ad_pool[p]->samples_per_second > configured) configured = ad_pool[p]->samples_per_second;
+    }
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        if (ad_running(ad_pool[p]) && rate % ad_rate(ad_pool[p]) != 0) return configured;
+    }
+    return rate;
+}
+
+static void ad_set_service_rate(const uint8_t rate);
+
+/**
+ * Handle the samples arriving from the accelerometer service at ``ad_service_rate``. The service
+ * may deliver any number of samples; every running pipeline packs the samples of its own rate.
+ * The ``timestamp`` is the time of the first sample in ``data``. The synthetic signal, if any,
+ * replaces the samples in ``data`` first.
+ */
+static void ad_raw_accel_data_handler(AccelRawData *data, uint32_t num_samples, uint64_t timestamp) {
+    sg_fill(&ad_generator, data, num_samples, timestamp, (uint16_t)((1000 << 8) / ad_service_rate));
+    bool changed = false;
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        struct ad_context_t *ad = ad_pool[p];
+        if (!ad_running(ad)) continue;
+
+        uint32_t first = (uint32_t)(ad->decimation - ad->phase) % ad->decimation;
+        ad->phase = (uint8_t)((ad->phase + num_samples) % ad->decimation);
+        if (first >= num_samples) continue;
+
+        uint32_t count = (num_samples - first + ad->decimation - 1) / ad->decimation;
+        if (ad_take(ad, data + first, ad->decimation, count, timestamp + first * 1000 / ad_service_rate)) changed = true;
+    }
+    // the service follows the pipelines in and out of the standby
+    if (changed) ad_set_service_rate(ad_running_rate());
+}
+
+/**
+ * Returns the rate of the accelerometer service for the running pipelines, with ``ad`` sampling
+ * at ``frequency``: the highest of the rates, 0 if the other rates are not its whole fractions.
+ */
+static uint8_t ad_required_rate(const struct ad_context_t *ad, const uint8_t frequency) {
+    uint8_t rate = frequency;
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        if (ad_pool[p] != ad && ad_running(ad_pool[p]) && ad_pool[p]->samples_per_second > rate) rate = ad_pool[p]->samples_per_second;
+    }
+    if (rate % frequency != 0) return 0;
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        if (ad_pool[p] != ad && ad_running(ad_pool[p]) && rate % ad_pool[p]->samples_per_second != 0) return 0;
+    }
+    return rate;
+}
+
+/**
+ * Samples the accelerometer service at ``rate``, or unsubscribes from it at 0, and sets the
+ * decimation of the running pipelines.
+ */
+static void ad_set_service_rate(const uint8_t rate) {
+    if (rate == 0) {
+        if (ad_service_rate != 0) accel_data_service_unsubscribe();
+        ad_service_rate = 0;
+        return;
+    }
+
+    if (ad_service_rate == 0) accel_raw_data_service_subscribe(AD_NUM_SAMPLES, ad_raw_accel_data_handler);
+    if (ad_service_rate != rate) accel_service_set_sampling_rate((AccelSamplingRate)rate);
+    ad_service_rate = rate;
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        struct ad_context_t *ad = ad_pool[p];
+        if (!ad_running(ad)) continue;
+        uint8_t decimation = rate / ad_rate(ad);
+        if (decimation != ad->decimation) ad->phase = 0;
+        ad->decimation = decimation;
+    }
+}
+
+ad_t *ad_open() {
+    for (int p = 0; p < MM_AD_INSTANCES; ++p) {
+        if (ad_pool[p] == NULL) ad_pool[p] = mm_reserve(sizeof(struct ad_context_t));
+        if (ad_pool[p] == NULL) return NULL;
+        if (ad_pool[p]->open) continue;
+
+        ad_pool[p]->open = true;
+        return ad_pool[p];
     }
+    return NULL;
 }
 
-int ad_start(const message_callback_t callback, const uint8_t frequency, const uint16_t maximum_time) {
-    if (ad_context.callback != NULL) return E_AD_ALREADY_RUNNING;
+void ad_close(ad_t *ad) {
+    if (ad == NULL) return;
+    ad_stop(ad);
+    ad->open = false;
+}
+
+int ad_start(ad_t *ad, const struct message_sink sink, const uint8_t frequency, const uint16_t maximum_time) {
+    if (ad == NULL) return E_AD_MEM;
+    if (ad_running(ad)) return E_AD_ALREADY_RUNNING;
+    if (sink.callback == NULL || !ad_valid_frequency(frequency) || maximum_time == 0) return E_AD_INVALID_CONFIG;
+    uint8_t rate = ad_required_rate(ad, frequency);
+    if (rate == 0) return E_AD_INVALID_CONFIG;
+
+    ad->sink = sink;
+    ad->samples_per_second = frequency;
+    ad->maximum_time = maximum_time;
+    ad->mode = AD_MODE_RAW;
+    ad->encoding = AD_ENCODING_PACKED;
+    ad->range = AD_DEFAULT_RANGE;
+    ad->buffer_position = 0;
+    ad->dropped_samples = 0;
+    ad->decimation = 0;
+    ad->phase = 0;
+    ad->standby = false;
+    ad->idle = false;
+    ad->quiet_time = 0;
 
-    ad_context.callback = callback;
-    ad_context.samples_per_second = frequency;
-    ad_context.maximum_time = maximum_time;
-    ad_context.start_time = TIME_NAN;
+    ad_set_service_rate(ad_running_rate());
 
-    accel_raw_data_service_subscribe(AD_NUM_SAMPLES, ad_raw_accel_data_handler);
-    accel_service_set_sampling_rate((AccelSamplingRate)frequency);
-    
     return 1;
 }
 
-int ad_stop() {
-    ad_context.callback = NULL;
+int ad_reconfigure(ad_t *ad, const uint8_t frequency, const uint16_t maximum_time) {
+    if (!ad_running(ad)) return E_AD_NOT_RUNNING;
+    if (!ad_valid_frequency(frequency) || maximum_time == 0) return E_AD_INVALID_CONFIG;
+    uint8_t rate = ad_required_rate(ad, frequency);
+    if (rate == 0) return E_AD_INVALID_CONFIG;
+
+    // flush what was captured at the old frequency
+    if (ad->buffer_position > 0) ad_submit(ad);
+
+    ad->samples_per_second = frequency;
+    ad->maximum_time = maximum_time;
+    // no standby at the frequencies it cannot decimate to
+    if (frequency % AD_STANDBY_RATE != 0) ad->idle = false;
+    ad_set_service_rate(ad_running_rate());
+
+    return 0;
+}
+
+int ad_set_mode(ad_t *ad, const uint8_t mode) {
+    if (!ad_running(ad)) return E_AD_NOT_RUNNING;
+    if (mode > AD_MODE_FEATURES) return E_AD_INVALID_CONFIG;
+    if (mode == ad->mode) return 0;
+
+    if (ad->buffer_position > 0) ad_submit(ad);
+    ad->mode = mode;
+
+    return 0;
+}
+
+int ad_set_encoding(ad_t *ad, const uint8_t encoding, const uint16_t range) {
+    if (!ad_running(ad)) return E_AD_NOT_RUNNING;
+    switch (encoding) {
+        case AD_ENCODING_PACKED: case AD_ENCODING_ENTROPY: break;
+        case AD_ENCODING_8_BITS: case AD_ENCODING_10_BITS: case AD_ENCODING_12_BITS:
+            if (range == 0) return E_AD_INVALID_CONFIG;
+            break;
+        default: return E_AD_INVALID_CONFIG;
+    }
+    if (encoding == ad->encoding && range == ad->range) return 0;
+
+    if (ad->buffer_position > 0) ad_submit(ad);
+    ad->encoding = encoding;
+    ad->range = range;
+
+    return 0;
+}
+
+int ad_stop(ad_t *ad) {
+    if (!ad_running(ad)) return E_AD_NOT_RUNNING;
+
+    // the last batch is usually only partially filled
+    if (ad->buffer_position > 0) ad_submit(ad);
+    ad->sink.callback = NULL;
+
+    ad->idle = false;
+
+    // the remaining pipelines may do with a lower rate
+    ad_set_service_rate(ad_running_rate());
+
     return 1;
 }
+
+int ad_set_standby(ad_t *ad, const bool standby) {
+    if (!ad_running(ad)) return E_AD_NOT_RUNNING;
+    if (standby == ad->standby) return 0;
+
+    ad->standby = standby;
+    ad->quiet_time = 0;
+    if (standby && ad->samples_per_second % AD_STANDBY_RATE == 0) ad_sleep(ad);
+    // the movement that the pre-roll waited for did not come
+    if (!standby) ad->idle = false;
+    ad_set_service_rate(ad_running_rate());
+
+    return 0;
+}
+
+void ad_push(ad_t *ad, const AccelRawData *data, const uint32_t num_samples, const uint64_t timestamp) {
+    if (!ad_running(ad)) return;
+    if (ad_take(ad, data, 1, num_samples, timestamp)) ad_set_service_rate(ad_running_rate());
+}
+
+int ad_set_signal(const uint8_t signal) {
+    if (signal == SG_SIGNAL_PATTERN) return E_AD_INVALID_CONFIG;
+    return sg_start(&ad_generator, signal, 1) == 0 ? 0 : E_AD_INVALID_CONFIG;
+}
+
+uint32_t ad_get_dropped_samples(const ad_t *ad) {
+    if (ad == NULL) return 0;
+    return ad->dropped_samples;
+}
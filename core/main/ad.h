@@ -7,10 +7,54 @@
 
 #define E_AD_ALREADY_RUNNING -1
 #define E_AD_MEM -2
+#define E_AD_NOT_RUNNING -3
+#define E_AD_INVALID_CONFIG -4
 
-// power-of-two samples at a time
+// the sample encodings: 13 bits per axis in ``struct threed_data``, the same entropy-coded by am
+// (see ec.h), or the given number of bits per axis quantised over the configured range, packed
+// least significant bit first. The entropy coding is lossless; with the placeholder table of ec.h it
+// codes the movements at about 1.7x of the packed samples, short of the 3-4x it was meant for
+#define AD_ENCODING_PACKED 0
+#define AD_ENCODING_ENTROPY 1
+#define AD_ENCODING_8_BITS 8
+#define AD_ENCODING_10_BITS 10
+#define AD_ENCODING_12_BITS 12
+
+// the range in mg of the quantised encodings, unless configured: ±4 g, the accelerometer's full scale
+#define AD_DEFAULT_RANGE 4000
+
+// the header types of the submitted buffers
+#define AD_TYPE_ACCELEROMETER 0x516c6174
+#define AD_TYPE_FEATURES 0x516c6166
+
+// the number of values in one ``struct threed_features``
+#define AD_FEATURES_VALUES 6
+
+// all samples submitted
+#define AD_MODE_RAW 0
+// only the buffers with movement submitted
+#define AD_MODE_GATED 1
+// only the ``struct threed_features`` of every buffer submitted
+#define AD_MODE_FEATURES 2
+
+// the sum of the mean absolute deviations of the axes below which a buffer has no movement
+#define AD_MOTION_THRESHOLD 60
+
+// samples per accelerometer service update; the handler accepts any other count, too
 #define AD_NUM_SAMPLES 10
 
+// the rate of the standby that waits for the movement, the samples kept ahead of the movement (2 s),
+// and the time in ms without movement after which the standby takes over again
+#define AD_STANDBY_RATE 10
+#define AD_PREROLL_LENGTH 20
+#define AD_STANDBY_AFTER 10000
+
+/**
+ * The handle of one capture pipeline. The pipelines share the accelerometer service, which samples
+ * at the highest of their rates; the pipelines at the lower rates keep every n-th sample.
+ */
+typedef struct ad_context_t ad_t;
+
 /**
  * Packed 6 B of the accelerometer values
  */
@@ -21,24 +65,121 @@ struct __attribute__((__packed__)) threed_data {
     int16_t _ : 1; // spare bit to fit on 5 bytes
 };
 
+/**
+ * Packed 12 B of the features of one buffer: the means and the mean absolute deviations of the axes
+ */
+struct __attribute__((__packed__)) threed_features {
+    int16_t x_mean;
+    int16_t y_mean;
+    int16_t z_mean;
+    uint16_t x_deviation;
+    uint16_t y_deviation;
+    uint16_t z_deviation;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// the AccelRawData of ad_push(...)
+#include <pebble.h>
+
+///
+/// Takes a free pipeline, reserving its state in the arena the first time it is taken.
+///
+/// Returns the pipeline, ``NULL`` if all ``MM_AD_INSTANCES`` pipelines are taken or the arena is full
+///
+ad_t *ad_open();
+
+///
+/// Stops the ``ad`` pipeline if it is recording and returns it to the free pipelines.
+///
+void ad_close(ad_t *ad);
+
+///
+/// Starts the accelerometer recording of the ``ad`` pipeline, submits the data captured at the
+/// given ``frequency`` to the ``sink``. The ``sink`` is expected to perform
+/// some kind of I/O to transmit the data to some client. The ``frequency`` must be a whole
+/// fraction or a multiple of the frequencies of the other running pipelines.
+///
+/// Returns 0 for success, negative values for failures
+///
+int ad_start(ad_t *ad, const struct message_sink sink, const uint8_t frequency, const uint16_t maximum_time);
+
 ///
-/// Starts the accelerometer recording, submits the data captured at the given
-/// ``frequency`` to the ``callback``. The ``callback`` is expected to perform
-/// some kind of I/O to transmit the data to some client.
+/// Switches the running recording to the new ``frequency`` and ``maximum_time``.
+/// The samples captured so far are submitted to the sink first, so that
+/// no buffered samples are lost and every submitted buffer has a single frequency.
 ///
 /// Returns 0 for success, negative values for failures
 ///
-int ad_start(const message_callback_t callback, const uint8_t frequency, const uint16_t maximum_time);
+int ad_reconfigure(ad_t *ad, const uint8_t frequency, const uint16_t maximum_time);
+
+///
+/// Switches the running recording to the ``mode``, one of the ``AD_MODE_*`` values.
+/// The samples captured so far are submitted in the old mode first. In ``AD_MODE_FEATURES``
+/// the sink receives one ``struct threed_features`` per buffer instead of the samples.
+///
+/// Returns 0 for success, negative values for failures
+///
+int ad_set_mode(ad_t *ad, const uint8_t mode);
+
+///
+/// Switches the running recording to the ``encoding``, one of the ``AD_ENCODING_*`` values.
+/// The quantised encodings clamp the samples to ±``range`` mg and scale them to the
+/// ``encoding`` bits per axis. ``AD_ENCODING_ENTROPY`` submits the ``struct threed_data`` samples
+/// for am to code. The samples captured so far are submitted in the old encoding first.
+/// The features are never quantised.
+///
+/// Returns 0 for success, negative values for failures
+///
+int ad_set_encoding(ad_t *ad, const uint8_t encoding, const uint16_t range);
+
+///
+/// Switches the wake on motion of the running recording on or off. In the standby, the pipeline
+/// samples at ``AD_STANDBY_RATE`` and submits nothing, keeping the last ``AD_PREROLL_LENGTH`` samples.
+/// The first movement submits them, at ``AD_STANDBY_RATE``, and the recording goes on at its own
+/// frequency until ``AD_STANDBY_AFTER`` ms of the submitted samples have no movement. The recordings at
+/// the frequencies that are not multiples of ``AD_STANDBY_RATE`` have no standby.
+///
+/// Returns 0 for success, negative values for failures
+///
+int ad_set_standby(ad_t *ad, const bool standby);
+
+///
+/// Stops the accelerometer recording of the ``ad`` pipeline, submitting the samples of the last,
+/// partially filled, buffer to the sink; the last pipeline to stop unsubscribes from the
+/// accelerometer service. After this call, no more calls to the sink passed to ``ad_start(...)``
+/// are expected; ``ad_start(...)`` may be called again to start a new recording.
+///
+/// Returns 1 for success, ``E_AD_NOT_RUNNING`` if there was no recording to stop
+///
+int ad_stop(ad_t *ad);
+
+///
+/// Packs the ``num_samples`` of ``data``, taken at the pipeline's frequency from ``timestamp`` (in ms),
+/// as if the accelerometer service delivered them to the ``ad`` pipeline alone. This lets the host
+/// tools feed their own samples to any number of pipelines. In the standby, the ``data`` must be
+/// taken at ``AD_STANDBY_RATE``.
+///
+void ad_push(ad_t *ad, const AccelRawData *data, const uint32_t num_samples, const uint64_t timestamp);
+
+///
+/// Replaces the samples of the accelerometer service, for all pipelines, with the synthetic
+/// ``signal``, one of the ``SG_SIGNAL_*`` values in sg.h, from the next update on; the signal starts
+/// with that update. ``SG_SIGNAL_NONE`` takes the accelerometer's own samples again. The signal
+/// stays selected across the recordings. The watch has no recorded samples to play, so
+/// ``SG_SIGNAL_PATTERN`` is for the host tools' own ``struct sg_generator`` only.
+///
+/// Returns 0 for success, ``E_AD_INVALID_CONFIG`` for an unknown signal or ``SG_SIGNAL_PATTERN``
+///
+int ad_set_signal(const uint8_t signal);
 
 ///
-/// Stops the accelerometer recording. After this call, no more calls to
-/// the ``callback`` function passed to ``ad_start(...)`` are expected.
+/// Returns the number of samples received since the last ``ad_start(...)`` that the sink
+/// could not keep, for example because the transport's queue was full.
 ///
-int ad_stop();
+uint32_t ad_get_dropped_samples(const ad_t *ad);
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,12 @@
 #include "compat.h"
 #include "am.h"
+#include "ad.h"
+#include "ts.h"
+#include "mm.h"
+#include "bp.h"
+#include "ec.h"
+#include "ck.h"
+#include "lg.h"
 #include <pebble.h>
 
 #define OUTB_B_CODE 32768
@@ -7,12 +14,112 @@
 #define OUTB_S_CODE 98304
 #define OUTB_F_CODE 131072
 #define MAX_SEND_FAILURES 200
+// the time between two clock synchronisation pings in ms
+#define TIME_SYNC_PERIOD 30000
+// the number of sample batches kept while they cannot be sent
+#define QUEUE_LENGTH 4
+// the largest sample batch that can be kept: the header and a full ad buffer
+#define SLOT_SIZE (sizeof(struct header) + AD_BUFFER_SIZE)
+// the number of control messages kept; they are sent ahead of the sample batches
+#define CONTROL_QUEUE_LENGTH 4
+// the largest control message
+#define CONTROL_SLOT_SIZE 8
+// the time in ms to wait for the acknowledgement of the sent batches before sending them again
+#define ACK_TIMEOUT 5000
+// the dictionary of one message: its 1 B count of tuples and the 7 B key, type and length of the only tuple
+#define DICT_OVERHEAD (1 + 7)
+
+// the kinds of the message in the outbox: it leaves its queue once the outbox sent handler confirms it
+#define AM_FLIGHT_CONTROL 0
+#define AM_FLIGHT_PARITY 1
+#define AM_FLIGHT_RESEND 2
+#define AM_FLIGHT_BATCH 3
+#define AM_FLIGHT_TIME_SYNC 4
+
+_Static_assert(AM_MAX_ACK_WINDOW < QUEUE_LENGTH, "the ack window leaves no slot for new batches");
+_Static_assert(DICT_OVERHEAD + SLOT_SIZE <= APP_MESSAGE_OUTBOX_SIZE, "a full sample batch does not fit in one App Message");
+_Static_assert(DICT_OVERHEAD + sizeof(struct parity_header) + SLOT_SIZE <= APP_MESSAGE_OUTBOX_SIZE, "a parity message does not fit in one App Message");
 
 /**
- * Context that holds the current callback and samples_per_second. It is used in the accelerometer
- * callback to calculate the G forces and to push the packed sample buffer to the callback.
+ * One sample batch waiting to be sent: the key and the header and payload
+ */
+struct am_slot {
+    uint32_t key;
+    uint16_t size;
+    uint16_t sequence_number;
+    bool acknowledged;
+    // the phone asked for the sent batch again
+    bool resend;
+    uint8_t buffer[SLOT_SIZE];
+};
+
+/**
+ * One control message waiting to be sent: the key and the payload
+ */
+struct am_control_slot {
+    uint32_t key;
+    uint16_t size;
+    uint8_t buffer[CONTROL_SLOT_SIZE];
+};
+
+/**
+ * The header fields of one stream of samples, and the pipeline it is sent by
+ */
+struct am_stream {
+    struct am_context_t *context;
+    uint32_t type;
+    uint8_t sample_size;
+    uint8_t samples_per_second;
+    // the number of values in one sample
+    uint8_t values;
+    // the AD_ENCODING_* of the samples and the range of the quantised encodings
+    uint8_t encoding;
+    uint16_t range;
+};
+
+/**
+ * The position of the messages of one priority in their ring of slots
+ */
+struct am_lane {
+    // the slot of the oldest message
+    uint8_t head;
+    // the number of messages
+    uint8_t count;
+    // the number of messages from the head sent and waiting for the acknowledgement
+    uint8_t sent;
+    // the number of messages before the head sent and kept until their slots are needed
+    uint8_t retained;
+    // the number of messages dropped from the full ring
+    uint32_t dropped_count;
+};
+
+/**
+ * The parity of the sample batches sent in the current group
+ */
+struct am_parity {
+    // the number of batches in one group, 0 for no parity messages
+    uint8_t group;
+    // the number of batches in the parity so far
+    uint8_t count;
+    // the group is complete and the parity waits to be sent
+    bool pending;
+    // the sequence number after the last batch sent
+    uint16_t next;
+    // the size of the longest batch in the parity
+    uint16_t size;
+    // the ``struct parity_header`` and the parity
+    uint8_t buffer[sizeof(struct parity_header) + SLOT_SIZE];
+};
+
+/**
+ * Context of one transport pipeline that holds its streams and the messages waiting to be sent.
+ * It is used in the stream callbacks to prepend the header and to queue the message.
  */
 struct am_context_t {
+    // its place in ``am_pool``
+    uint16_t index;
+    // between am_start(...) and am_stop(...)
+    bool running;
     // the number of packets sent
     uint32_t count;
     // the last error code
@@ -21,16 +128,75 @@ struct am_context_t {
     int last_error_distance;
     // the number of errors
     int error_count;
-    // transmission in progress
+    // a message of the pipeline is in the outbox, until the outbox sent or failed handler
     bool send_in_progress;
-
-    // the header fields
-    uint32_t type;
-    uint8_t sample_size;
-    uint8_t samples_per_second;
-    uint8_t sequence_number;
+    // the AM_FLIGHT_* of that message, and its slot in the queue of the sample batches
+    uint8_t in_flight;
+    uint8_t in_flight_slot;
+    // drain(...) is filling the outbox; the outbox handlers it causes leave the next message to it
+    bool draining;
+    // the outbox was busy with another message; the outbox handlers give the pipeline its turn
+    bool waiting;
+    // connected to the phone app
+    bool connected;
+
+    // the header fields of the streams; the first one is the accelerometer stream of am_start(...)
+    struct am_stream streams[AM_MAX_STREAMS];
+    uint8_t stream_count;
+    uint16_t sequence_number;
+
+    // the clock synchronisation with the phone
+    struct ts_state time_sync;
+    AppTimer *time_sync_timer;
+
+    // the control messages waiting to be sent; they preempt the sample batches
+    struct am_control_slot control_queue[CONTROL_QUEUE_LENGTH];
+    struct am_lane control_lane;
+    // the sample batches waiting to be sent
+    struct am_slot queue[QUEUE_LENGTH];
+    struct am_lane lane;
+    // the number of batches sent ahead of the acknowledgements, 0 for no acknowledgements
+    uint8_t ack_window;
+    AppTimer *ack_timer;
+    // the parity of the sample batches, sent ahead of the following batches
+    struct am_parity parity;
 };
 
+_Static_assert(sizeof(struct am_context_t) <= MM_AM_BUDGET, "am context exceeds its budget");
+
+// the pipelines, each reserved in the arena by the first am_start(...) that needs it
+static struct am_context_t *am_pool[MM_AM_INSTANCES];
+// the number of the pipelines waiting for their turn in the outbox
+static uint16_t am_waiting_count;
+
+/**
+ * Returns true if the pipeline has a message in the outbox or messages waiting to be sent, also after ``am_stop(...)``.
+ */
+static bool am_queued(const struct am_context_t *context) {
+    return context->send_in_progress || context->control_lane.count > 0 || context->lane.count > 0 || context->parity.pending;
+}
+
+/**
+ * Returns the number of the pipelines running or still sending the messages of their stopped sessions.
+ */
+static uint8_t am_active_count() {
+    uint8_t count = 0;
+    for (int p = 0; p < MM_AM_INSTANCES; ++p) {
+        if (am_pool[p] != NULL && (am_pool[p]->running || am_queued(am_pool[p]))) ++count;
+    }
+    return count;
+}
+
+/**
+ * The watch time in ms since the epoch
+ */
+static int64_t now_ms() {
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    return (int64_t)seconds * 1000 + ms;
+}
+
 static char *get_error_text(int code, char *result, size_t size) {
     if (size < 5) return "";
     if (size < 10) return strcpy(result, "E_MEM");
@@ -74,13 +240,10 @@ static bool send_buffer(struct am_context_t *context, const uint32_t key, const
 
         return false;
     }
-    if ((dictionary_result = dict_write_int32(message, 0x0c000000, context->count)) != DICT_OK) {
-        context->last_error = -DICT_W_CODE - dictionary_result;
-
-        return false;
-    }
 
     dict_write_end(message);
+    // the outbox handlers tell the pipeline of the message; the outbox is free, so no other message is in flight
+    app_message_set_context(context);
 
     if ((app_message_result = app_message_outbox_send()) != APP_MSG_OK) {
         context->last_error = -OUTB_S_CODE - app_message_result;
@@ -91,145 +254,680 @@ static bool send_buffer(struct am_context_t *context, const uint32_t key, const
     return true;
 }
 
-static void send_message(const uint32_t key, const uint8_t* payload_buffer, const uint16_t size, const double timestamp, const uint16_t duration) {
-    static const uint16_t payload_size_max = APP_MESSAGE_OUTBOX_SIZE - sizeof(struct header);
+/**
+ * Counts the message dropped from the full ``lane``.
+ */
+static void lane_dropped(struct am_lane *lane) {
+    ++lane->dropped_count;
+    LG_ERROR(LG_AM_DROPPED, lane->dropped_count);
+}
 
-    struct am_context_t *context = app_message_get_context();
-    if (context == NULL) return;
+/**
+ * Returns the index of the slot for a new message at the end of the ``lane`` of ``length`` slots,
+ * dropping the oldest message if the lane is full; the lane must have no sent messages.
+ */
+static uint8_t lane_push(struct am_lane *lane, const uint8_t length) {
+    if (lane->count == length) {
+        lane->head = (uint8_t)((lane->head + 1) % length);
+        --lane->count;
+        lane_dropped(lane);
+    }
+    // the slot of the oldest retained message, once the free slots are used up
+    if (lane->count + lane->retained == length) --lane->retained;
+    return (uint8_t)((lane->head + lane->count++) % length);
+}
 
-    if (context->error_count >= MAX_SEND_FAILURES) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "send_message: Stop sending. Too many send failures. Could be connectivity problem!");
-        return;
+/**
+ * Removes the oldest message from the ``lane`` of ``length`` slots.
+ */
+static void lane_pop(struct am_lane *lane, const uint8_t length) {
+    lane->head = (uint8_t)((lane->head + 1) % length);
+    --lane->count;
+    if (lane->sent > 0) --lane->sent;
+    ++lane->retained;
+}
+
+/**
+ * Returns the ``i``-th of the sent batches the ``context`` still holds: the retained ones, oldest
+ * first, and then the ones waiting for their acknowledgement.
+ */
+static struct am_slot *sent_slot(struct am_context_t *context, const uint8_t i) {
+    const struct am_lane *lane = &context->lane;
+    return &context->queue[(lane->head + QUEUE_LENGTH - lane->retained + i) % QUEUE_LENGTH];
+}
+
+/**
+ * Marks the ``context`` as ``waiting`` for its turn in the outbox, or not; the unchanged mark is not written.
+ */
+static void set_waiting(struct am_context_t *context, const bool waiting) {
+    if (context->waiting == waiting) return;
+    context->waiting = waiting;
+    if (waiting) ++am_waiting_count;
+    else --am_waiting_count;
+}
+
+/**
+ * Puts the message with the ``key`` and ``buffer`` in the outbox, where it is in flight until the outbox
+ * sent or failed handler; the message stays in its queue, in the ``slot`` of the sample batches for the
+ * AM_FLIGHT_* ``kind`` of batches, until the sent handler. A message the outbox does not take stays queued
+ * for the next attempt; the outbox busy with another pipeline's message is no failure.
+ */
+static bool send_slot(struct am_context_t *context, const uint8_t kind, const uint8_t slot, const uint32_t key, const uint8_t *buffer, const uint16_t size) {
+    context->send_in_progress = true;
+    context->in_flight = kind;
+    context->in_flight_slot = slot;
+    if (send_buffer(context, key, buffer, size)) {
+        LG_DEBUG(LG_AM_SENT, key, size);
+        ++context->count;
+        return true;
     }
 
-    if (context->send_in_progress) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "send_message: dropped message.");
+    context->send_in_progress = false;
+    if (context->last_error == -OUTB_B_CODE - APP_MSG_BUSY || context->last_error == -OUTB_S_CODE - APP_MSG_BUSY) set_waiting(context, true);
+    else ++context->error_count;
+    LG_DEBUG(LG_AM_NOT_SENT, context->last_error, size, context->error_count);
+    return false;
+}
+
+/**
+ * Returns ``true`` if the sent ``slot`` ends the parity group before it: a batch after a gap in the
+ * sequence numbers, or the end of the session. The batches sent again are not in any new group.
+ */
+static bool parity_ends(const struct am_parity *parity, const struct am_slot *slot) {
+    if (parity->count == 0) return false;
+    return slot->key != msg_ad || (int16_t)(slot->sequence_number - parity->next) > 0;
+}
+
+/**
+ * Adds the sent ``slot`` to the parity, and completes the group with its last batch.
+ */
+static void parity_add(struct am_parity *parity, const struct am_slot *slot) {
+    if (slot->key != msg_ad) return;
+    // sent again, it is in a parity already
+    if ((int16_t)(slot->sequence_number - parity->next) < 0) return;
+    if (parity->group == 0) {
+        parity->next = (uint16_t)(slot->sequence_number + 1);
         return;
     }
 
-    context->send_in_progress = true;
+    struct parity_header *header = (struct parity_header *)parity->buffer;
+    uint8_t *data = parity->buffer + sizeof(struct parity_header);
+    if (parity->count == 0) {
+        header->first = slot->sequence_number;
+        header->size = 0;
+        parity->size = 0;
+    }
+    // the shorter batches are padded with zeros
+    if (slot->size > parity->size) {
+        memset(data + parity->size, 0, slot->size - parity->size);
+        parity->size = slot->size;
+    }
+    for (uint16_t i = 0; i < slot->size; ++i) data[i] ^= slot->buffer[i];
+    header->size ^= slot->size;
+    header->count = ++parity->count;
+    parity->next = (uint16_t)(slot->sequence_number + 1);
+    if (parity->count == parity->group) parity->pending = true;
+}
 
-    if (size > payload_size_max) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "send_message: needed %d, had %d B.", size, payload_size_max);
-        EXIT(-3);
+static void ack_timed_out(void *data);
+
+/**
+ * Puts the next queued message in the outbox: the oldest control message if there is one, and the oldest
+ * unsent sample batch otherwise, so that the feedback does not wait behind the sample backlog. With the
+ * acknowledgements, the sent batches stay queued, and at most ``ack_window`` of them are sent ahead of the
+ * acknowledgements. The parity of a complete group goes ahead of the following batches. The message leaves
+ * its queue in ``message_sent(...)``.
+ * Returns ``false`` if there is nothing to send, or the outbox did not take the message.
+ */
+static bool send_next(struct am_context_t *context) {
+    for (;;) {
+        if (context->control_lane.count > 0) {
+            const struct am_control_slot *slot = &context->control_queue[context->control_lane.head];
+            return send_slot(context, AM_FLIGHT_CONTROL, 0, slot->key, slot->buffer, slot->size);
+        }
+
+        struct am_parity *parity = &context->parity;
+        if (parity->pending) {
+            return send_slot(context, AM_FLIGHT_PARITY, 0, msg_parity, parity->buffer, (uint16_t)(sizeof(struct parity_header) + parity->size));
+        }
+
+        struct am_lane *lane = &context->lane;
+        for (uint8_t i = 0; i < lane->retained + lane->sent; ++i) {
+            const struct am_slot *slot = sent_slot(context, i);
+            if (!slot->resend) continue;
+            return send_slot(context, AM_FLIGHT_RESEND, (uint8_t)(slot - context->queue), slot->key, slot->buffer, slot->size);
+        }
+
+        if (lane->sent == lane->count) return false;
+        if (context->ack_window > 0 && lane->sent >= context->ack_window) return false;
+        const uint8_t index = (uint8_t)((lane->head + lane->sent) % QUEUE_LENGTH);
+        const struct am_slot *slot = &context->queue[index];
+        // acknowledged out of order, it only waits for the batches before it
+        if (context->ack_window > 0 && slot->acknowledged) {
+            ++lane->sent;
+            continue;
+        }
+        if (parity_ends(parity, slot)) {
+            parity->pending = true;
+            continue;
+        }
+        return send_slot(context, AM_FLIGHT_BATCH, index, slot->key, slot->buffer, slot->size);
     }
+}
 
-    uint8_t message_buffer[APP_MESSAGE_OUTBOX_SIZE];
-    memcpy(message_buffer + sizeof(struct header), payload_buffer, size);
-    for (int i = 0; i < 5; ++i) {
-        struct header *header = (struct header *) message_buffer;
-        header->preamble1 = 0x61;
-        header->preamble2 = 0x65;
-        header->types_count = 1;
-        header->samples_per_second = context->samples_per_second;
-        header->timestamp = timestamp;
-        header->count = (uint32_t) (size / context->sample_size) * 3; // number of values
-        header->type = context->type;
-
-        // header->sequence_number = context->sequence_number;
-        // header->duration = duration;
-
-        if (send_buffer(context, key, message_buffer, (uint16_t) (size + sizeof(struct header)))) {
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "send_message: sent %lu samples, at %g", header->count, timestamp);
-            ++context->count;
+/**
+ * Removes the message the phone received from its queue. Without the acknowledgements, a sample batch is
+ * done with; with them, it is sent and waits for its acknowledgement.
+ */
+static void message_sent(struct am_context_t *context) {
+    struct am_lane *lane = &context->lane;
+    switch (context->in_flight) {
+        case AM_FLIGHT_CONTROL:
+            lane_pop(&context->control_lane, CONTROL_QUEUE_LENGTH);
+            break;
+        case AM_FLIGHT_PARITY:
+            context->parity.pending = false;
+            context->parity.count = 0;
+            break;
+        case AM_FLIGHT_RESEND:
+            context->queue[context->in_flight_slot].resend = false;
+            break;
+        case AM_FLIGHT_BATCH:
+            parity_add(&context->parity, &context->queue[context->in_flight_slot]);
+            // the batches sent again after an acknowledgement timeout are past the in-flight one
+            if (context->in_flight_slot != (lane->head + lane->sent) % QUEUE_LENGTH) break;
+            if (context->ack_window == 0) {
+                lane_pop(lane, QUEUE_LENGTH);
+                break;
+            }
+            ++lane->sent;
+            if (context->ack_timer == NULL) context->ack_timer = app_timer_register(ACK_TIMEOUT, ack_timed_out, context);
+            break;
+    }
+}
+
+/**
+ * Sends the queued messages one at a time while the phone is connected: the outbox holds one message,
+ * so the next one goes when the outbox sent or failed handler frees it. A message the outbox does not
+ * take waits for the next event of the pipeline: a new message, an acknowledgement or a reconnection.
+ */
+static void drain(struct am_context_t *context) {
+    // called from the outbox handlers of the message just put in the outbox; the loop below goes on
+    if (context->draining) return;
+
+    context->draining = true;
+    set_waiting(context, false);
+    while (context->connected && !context->send_in_progress) {
+        if (context->error_count >= MAX_SEND_FAILURES) {
+            LG_ERROR(LG_AM_SENDING_STOPPED, context->error_count);
             break;
-        } else {
-            char err[20];
-            get_error_text(context->last_error, err, 20);
-            ++context->error_count;
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "send_message: not sent: %s. Size: %u, error_count: %i", err, (uint16_t) (size + sizeof(struct header)), context->error_count);
-            psleep(200);
         }
+        if (!send_next(context)) break;
     }
+    context->draining = false;
+}
+
+/**
+ * Sends the batches sent and not acknowledged again, oldest first.
+ */
+static void resend_unacknowledged(struct am_context_t *context) {
+    if (context->ack_timer != NULL) {
+        app_timer_cancel(context->ack_timer);
+        context->ack_timer = NULL;
+    }
+    if (context->lane.sent == 0) return;
+
+    LG_DEBUG(LG_AM_RESENDING, context->lane.sent);
+    context->lane.sent = 0;
+    // the acknowledgements keep the batches, so there is no reason to give up on them
+    context->error_count = 0;
+    drain(context);
+}
+
+/**
+ * Sends the batches that were not acknowledged in time again.
+ */
+static void ack_timed_out(void *data) {
+    struct am_context_t *context = data;
+    if (!context->running) return;
+
+    context->ack_timer = NULL;
+    resend_unacknowledged(context);
+}
+
+/**
+ * Queues the message with the ``key`` and the ``size`` B of ``payload_buffer`` behind its header,
+ * and sends what it can. Returns ``false`` if the message was not queued.
+ */
+static bool send_message(const uint32_t key, const struct am_stream *stream, const uint8_t* payload_buffer, const uint16_t size, const double timestamp, const uint16_t sample_interval) {
+    static const uint16_t payload_size_max = SLOT_SIZE - sizeof(struct header);
+
+    struct am_context_t *context = stream->context;
+    if (!context->running) return false;
+
+    if (size > payload_size_max) {
+        LG_ERROR(LG_AM_TOO_LARGE, size, payload_size_max);
+        EXIT(-3);
+        return false;
+    }
+
+    // the batches waiting for their acknowledgement are never dropped, and go again once it times
+    // out; the new batch is, and its sequence number is skipped, so that the phone sees the gap
+    struct am_lane *lane = &context->lane;
+    if (lane->count == QUEUE_LENGTH) drain(context);
+    if (lane->count == QUEUE_LENGTH) {
+        lane_dropped(lane);
+        ++context->sequence_number;
+        return false;
+    }
+    struct am_slot *slot = &context->queue[lane_push(lane, QUEUE_LENGTH)];
+    uint8_t encoding = stream->encoding;
+    uint16_t payload_size = 0;
+    if (encoding == AD_ENCODING_ENTROPY) {
+        payload_size = ec_encode((const struct threed_data *)payload_buffer, size / sizeof(struct threed_data),
+                                 slot->buffer + sizeof(struct header), payload_size_max);
+    }
+    // the samples that do not compress into the slot go as they are
+    if (payload_size == 0) {
+        if (encoding == AD_ENCODING_ENTROPY) encoding = AD_ENCODING_PACKED;
+        payload_size = size;
+        memcpy(slot->buffer + sizeof(struct header), payload_buffer, size);
+    }
+    slot->key = key;
+    slot->size = (uint16_t) (payload_size + sizeof(struct header));
+    slot->sequence_number = context->sequence_number;
+    slot->acknowledged = false;
+    slot->resend = false;
+
+    struct header *header = (struct header *) slot->buffer;
+    header->preamble1 = 0x61;
+    header->preamble2 = 0x65;
+    header->types_count = 1;
+    header->samples_per_second = stream->samples_per_second;
+    header->timestamp = timestamp == 0 ? 0 : (double)ts_phone_time(&context->time_sync, (int64_t)(timestamp * 1000 + 0.5)) / 1000;
+    header->sample_interval = sample_interval;
+    header->sequence_number = context->sequence_number;
+    header->encoding = encoding;
+    header->range = stream->range;
+    // number of values; the quantised samples are packed to encoding bits per value
+    if (stream->encoding < AD_ENCODING_8_BITS) {
+        header->count = (uint32_t) (size / stream->sample_size) * stream->values;
+    } else {
+        header->count = (uint32_t) (size * 8 / (stream->encoding * stream->values)) * stream->values;
+    }
+    header->type = stream->type;
+    header->crc = ck_message_crc(slot->buffer, slot->size);
+
     ++context->sequence_number;
-    context->send_in_progress = false;
+
+    drain(context);
+    return true;
 }
 
 __unused // not really, it's used in main.c
-void am_send_simple(const msgkey_t key, const uint8_t value) {
-    struct am_context_t *context = app_message_get_context();
-    if (context == NULL) return;
-    if (context->send_in_progress) {
-        APP_LOG(APP_LOG_LEVEL_ERROR, "send_message: dropped message.");
+void am_send_simple(am_t *context, const msgkey_t key, const uint8_t value) {
+    if (context == NULL || !context->running) return;
+
+    // the oldest control message stays while it is in the outbox; the new one is dropped instead
+    struct am_lane *lane = &context->control_lane;
+    if (lane->count == CONTROL_QUEUE_LENGTH && context->send_in_progress && context->in_flight == AM_FLIGHT_CONTROL) {
+        lane_dropped(lane);
         return;
     }
+    struct am_control_slot *slot = &context->control_queue[lane_push(lane, CONTROL_QUEUE_LENGTH)];
+    slot->key = key;
+    slot->size = 1;
+    slot->buffer[0] = value;
+
+    drain(context);
+}
+
+/**
+ * Sends the samples of the stream in the ``context``.
+ */
+static bool stream_callback(void *context, const uint8_t* payload_buffer, const uint16_t size, const double timestamp, const uint16_t sample_interval) {
+    return send_message(msg_ad, context, payload_buffer, size, timestamp, sample_interval);
+}
+
+/**
+ * Sends the ping of the clock synchronisation with the current watch time, and schedules the next one.
+ * A ping that cannot be sent right now is skipped; its delay would be useless anyway.
+ */
+static void send_time_sync(void *data) {
+    struct am_context_t *context = data;
+    if (!context->running) return;
+
+    context->time_sync_timer = app_timer_register(TIME_SYNC_PERIOD, send_time_sync, context);
+    if (context->send_in_progress || !context->connected) return;
 
     context->send_in_progress = true;
-    for (int i = 0; i < 5; ++i) {
-        uint8_t message_buffer[1] = {value};
-        if (send_buffer(context, key, message_buffer, 1)) {
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "am_send_simple: sent.");
-            ++context->count;
-            break;
-        } else {
-            char err[20];
-            get_error_text(context->last_error, err, 20);
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "send_message: not sent: %s", err);
-            psleep(200);
+    context->in_flight = AM_FLIGHT_TIME_SYNC;
+    int64_t watch_sent = now_ms();
+    if (!send_buffer(context, msg_time_sync, (uint8_t *)&watch_sent, sizeof(watch_sent))) {
+        context->send_in_progress = false;
+        LG_DEBUG(LG_AM_TIME_SYNC_NOT_SENT, context->last_error);
+    }
+}
+
+void am_time_sync_received(am_t *context, const uint8_t *buffer, const uint16_t size) {
+    int64_t watch_received = now_ms();
+    if (context == NULL || !context->running) return;
+    if (size != sizeof(struct time_sync_reply)) return;
+
+    struct time_sync_reply reply;
+    memcpy(&reply, buffer, sizeof(struct time_sync_reply));
+    if (ts_add(&context->time_sync, reply.watch_sent, reply.phone_received, reply.phone_sent, watch_received) != 0) {
+        LG_DEBUG(LG_AM_TIME_SYNC_IGNORED);
+    }
+}
+
+void am_set_ack_window(am_t *context, const uint8_t window) {
+    if (context == NULL || !context->running) return;
+
+    context->ack_window = window > AM_MAX_ACK_WINDOW ? AM_MAX_ACK_WINDOW : window;
+    // without the acknowledgements, the sent batches are done with
+    if (context->ack_window == 0) {
+        while (context->lane.sent > 0) lane_pop(&context->lane, QUEUE_LENGTH);
+    }
+    drain(context);
+}
+
+void am_resend_requested(am_t *context, const uint8_t *buffer, const uint16_t size) {
+    if (context == NULL || !context->running) return;
+
+    struct am_lane *lane = &context->lane;
+    for (uint16_t offset = 0; offset + sizeof(uint16_t) <= size; offset += sizeof(uint16_t)) {
+        uint16_t sequence_number;
+        memcpy(&sequence_number, buffer + offset, sizeof(uint16_t));
+        for (uint8_t i = 0; i < lane->retained + lane->sent; ++i) {
+            struct am_slot *slot = sent_slot(context, i);
+            if (slot->sequence_number == sequence_number) slot->resend = true;
         }
+        LG_DEBUG(LG_AM_RESEND_REQUESTED, sequence_number);
     }
-    context->send_in_progress = false;
+    drain(context);
 }
 
-void sample_callback(const uint8_t* payload_buffer, const uint16_t size, const double timestamp, const uint16_t duration) {
-    send_message(msg_ad, payload_buffer, size, timestamp, duration);
+void am_set_fec_group(am_t *context, const uint8_t group) {
+    if (context == NULL || !context->running) return;
+
+    struct am_parity *parity = &context->parity;
+    const uint8_t size = group > AM_MAX_FEC_GROUP ? AM_MAX_FEC_GROUP : group;
+    // the group of the batches sent so far ends with the parity of the previous size
+    if (parity->count > 0 && size != parity->group) parity->pending = true;
+    parity->group = size;
+    drain(context);
 }
 
-static void send_succeded() {
-    struct am_context_t *context = app_message_get_context();
-    if (context == NULL) return;
-    if (context->error_count == 0) return;
+void am_ack_received(am_t *context, const uint8_t *buffer, const uint16_t size) {
+    if (context == NULL || !context->running) return;
+    if (size != sizeof(struct ack_range)) return;
+
+    struct ack_range range;
+    memcpy(&range, buffer, sizeof(struct ack_range));
+    struct am_lane *lane = &context->lane;
+    for (uint8_t i = 0; i < lane->sent; ++i) {
+        struct am_slot *slot = &context->queue[(lane->head + i) % QUEUE_LENGTH];
+        // in the range, also when the sequence numbers wrap around
+        if ((uint16_t)(slot->sequence_number - range.first) <= (uint16_t)(range.last - range.first)) slot->acknowledged = true;
+    }
 
-    context->error_count = 0;
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "send_succeded: Message sent, resting error_cout to zero");
+    bool progress = false;
+    while (lane->sent > 0 && context->queue[lane->head].acknowledged) {
+        lane_pop(lane, QUEUE_LENGTH);
+        progress = true;
+    }
+    // the timeout counts from the last progress
+    if (progress && context->ack_timer != NULL) {
+        app_timer_cancel(context->ack_timer);
+        context->ack_timer = NULL;
+    }
+    if (lane->sent > 0 && context->ack_timer == NULL) context->ack_timer = app_timer_register(ACK_TIMEOUT, ack_timed_out, context);
+
+    drain(context);
 }
 
-static void send_failed(DictionaryIterator __unused *iterator, AppMessageResult __unused reason, void __unused *context) {
+/**
+ * Gives the free outbox to the pipelines it turned away while busy, in turns from the one after the
+ * ``context`` whose message just left it, and then to the ``context``, so that a pipeline with a long
+ * queue does not keep the outbox from the others. The ``NULL`` ``context`` of a message that is no
+ * pipeline's starts the turns with the first pipeline.
+ */
+static void drain_turns(struct am_context_t *context) {
+    const uint16_t first = context == NULL ? 0 : (uint16_t)(context->index + 1);
+    for (uint16_t i = 0; i < MM_AM_INSTANCES && am_waiting_count > 0; ++i) {
+        struct am_context_t *next = am_pool[(first + i) % MM_AM_INSTANCES];
+        if (next == NULL || next == context || !next->waiting) continue;
+
+        drain(next);
+        if (!next->send_in_progress) continue;
+        // the outbox is taken again, so the ``context`` waits for its turn
+        if (context != NULL && am_queued(context)) set_waiting(context, true);
+        return;
+    }
+    if (context != NULL) drain(context);
+}
+
+/**
+ * Frees the outbox of the pipeline in the ``data`` for the next message, and removes the sent message
+ * from its queue. The sent message shows that the link works again. A stopped pipeline sends what it
+ * queued before ``am_stop(...)``.
+ */
+static void send_succeded(DictionaryIterator __unused *iterator, void *data) {
+    struct am_context_t *context = data;
+    if (context != NULL) {
+        if (!context->send_in_progress) return;
+
+        context->send_in_progress = false;
+        message_sent(context);
+        if (context->error_count > 0) {
+            LG_DEBUG(LG_AM_FAILURES_RESET, context->error_count);
+            context->error_count = 0;
+        }
+    }
+    drain_turns(context);
+    // the last message of the last stopped pipeline tears down the shared handlers
+    if (context != NULL && !context->running && !am_queued(context) && am_active_count() == 0) connection_service_unsubscribe();
+}
+
+/**
+ * Frees the outbox of the pipeline in the ``data`` after the phone did not receive its message. The
+ * message stays in its queue and goes again, also when the connection was lost while it was in the outbox.
+ */
+static void send_failed(DictionaryIterator __unused *iterator, AppMessageResult reason, void *data) {
+    struct am_context_t *context = data;
+    if (context != NULL) {
+        if (!context->send_in_progress) return;
+
+        context->send_in_progress = false;
+        context->last_error = -OUTB_F_CODE - reason;
+        ++context->error_count;
+        LG_DEBUG(LG_AM_NOT_SENT, context->last_error, 0, context->error_count);
+    }
+    drain_turns(context);
+}
+
+/**
+ * Stops the sending of all pipelines while the phone app is disconnected, and sends the queued
+ * messages as soon as it reconnects; the stopped pipelines, too, until their queues are empty.
+ */
+static void connection_changed(bool connected) {
+    for (int p = 0; p < MM_AM_INSTANCES; ++p) {
+        struct am_context_t *context = am_pool[p];
+        if (context == NULL || !(context->running || am_queued(context))) continue;
+
+        LG_INFO(LG_AM_CONNECTION, connected, context->lane.count);
+        context->connected = connected;
+        if (!connected) continue;
+
+        // the failures were most likely caused by the lost connection
+        context->error_count = 0;
+        drain(context);
+    }
 }
 
-message_callback_t am_start(uint32_t type, uint8_t samples_per_second, uint8_t sample_size) {
-    struct am_context_t *context = malloc(sizeof(struct am_context_t));
+am_t *am_start(uint32_t type, uint8_t samples_per_second, uint8_t sample_size) {
+    // a stopped pipeline still sending the messages of its session is taken only if no other is free
+    struct am_context_t *context = NULL;
+    struct am_context_t *queued = NULL;
+    bool no_space = false;
+    for (int p = 0; p < MM_AM_INSTANCES && context == NULL; ++p) {
+        if (am_pool[p] == NULL && (am_pool[p] = mm_reserve(sizeof(struct am_context_t))) != NULL) am_pool[p]->index = (uint16_t)p;
+        if (am_pool[p] == NULL) {
+            no_space = true;
+            break;
+        }
+        if (am_pool[p]->running) continue;
+        if (!am_queued(am_pool[p])) context = am_pool[p];
+        else if (queued == NULL) queued = am_pool[p];
+    }
+    if (context == NULL) context = queued;
+    if (context == NULL) {
+        if (no_space) LG_ERROR(LG_AM_NO_SPACE);
+        else LG_ERROR(LG_AM_ALL_RUNNING, MM_AM_INSTANCES);
+        return NULL;
+    }
+    bool active = am_active_count() > 0;
+
     context->count = 0;
     context->error_count = 0;
     context->last_error = 0;
     context->last_error_distance = 0;
 
-    context->type = type;
-    context->sample_size = sample_size;
-    context->samples_per_second = samples_per_second;
-    context->sequence_number = 0;
-    context->send_in_progress = false;
+    context->streams[0] = (struct am_stream) { context, type, sample_size, samples_per_second, 3, AD_ENCODING_PACKED, 0 };
+    context->stream_count = 1;
+    context->connected = connection_service_peek_pebble_app_connection();
+    // the messages the stopped session queued go ahead of the new session's, which numbers its messages on
+    if (!am_queued(context)) {
+        context->sequence_number = 0;
+        context->control_lane = (struct am_lane) { 0 };
+        context->lane = (struct am_lane) { 0 };
+        context->parity.count = 0;
+        context->parity.next = 0;
+        set_waiting(context, false);
+    }
+    // the phone asks for the batches of the stopped session no more
+    context->lane.retained = 0;
+    context->lane.dropped_count = 0;
+    context->control_lane.dropped_count = 0;
+    context->ack_window = 0;
+    if (context->ack_timer != NULL) app_timer_cancel(context->ack_timer);
+    context->ack_timer = NULL;
+    context->parity.group = 0;
+    ts_reset(&context->time_sync);
+    context->time_sync_timer = app_timer_register(TIME_SYNC_PERIOD, send_time_sync, context);
+
+    // the first pipeline sets up the handlers all pipelines share
+    if (!active) {
+        app_message_register_outbox_sent(send_succeded);
+        app_message_register_outbox_failed(send_failed);
+        connection_service_subscribe((ConnectionHandlers) {
+                .pebble_app_connection_handler = connection_changed
+        });
+    }
+    context->running = true;
 
-    app_message_set_context(context);
-    app_message_register_outbox_sent(send_succeded);
-    app_message_register_outbox_failed(send_failed);
+    return context;
+}
+
+struct message_sink am_sink(am_t *context) {
+    if (context == NULL || !context->running) return (struct message_sink) { NULL, NULL };
+    return (struct message_sink) { stream_callback, &context->streams[0] };
+}
+
+void am_set_encoding(am_t *context, uint8_t encoding, uint16_t range) {
+    if (context == NULL || !context->running) return;
 
-    return &sample_callback;
+    context->streams[0].encoding = encoding;
+    context->streams[0].range = range;
 }
 
-void am_stop() {
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "am_stop() stopping...");
+struct message_sink am_add_stream(am_t *context, uint32_t type, uint8_t samples_per_second, uint8_t sample_size, uint8_t values) {
+    if (context == NULL || !context->running) return (struct message_sink) { NULL, NULL };
 
-    struct am_context_t *context = app_message_get_context();
+    uint8_t i = 0;
+    while (i < context->stream_count && context->streams[i].type != type) ++i;
+    if (i == AM_MAX_STREAMS) return (struct message_sink) { NULL, NULL };
+
+    context->streams[i] = (struct am_stream) { context, type, sample_size, samples_per_second, values, AD_ENCODING_PACKED, 0 };
+    if (i == context->stream_count) ++context->stream_count;
+    return (struct message_sink) { stream_callback, &context->streams[i] };
+}
+
+void am_reconfigure(am_t *context, uint32_t type, uint8_t samples_per_second, uint8_t sample_size, uint8_t values) {
+    if (context == NULL || !context->running) return;
+
+    context->streams[0].type = type;
+    context->streams[0].samples_per_second = samples_per_second;
+    context->streams[0].sample_size = sample_size;
+    context->streams[0].values = values;
+}
+
+int am_read_config(const uint8_t *buffer, const uint16_t size, struct session_config *config) {
+    config->samples_per_second = AM_DEFAULT_SAMPLES_PER_SECOND;
+    config->maximum_time = AM_DEFAULT_MAXIMUM_TIME;
+    config->encoding = AD_ENCODING_PACKED;
+    config->types = AM_STREAM_ACCELEROMETER;
+    config->decimated_below = BP_DEFAULT_DECIMATED_BELOW;
+    config->gated_below = BP_DEFAULT_GATED_BELOW;
+    config->features_below = BP_DEFAULT_FEATURES_BELOW;
+    config->ack_window = 0;
+    config->range = AD_DEFAULT_RANGE;
+    config->fec_group = 0;
+    config->standby = 0;
+    if (buffer != NULL) memcpy(config, buffer, size < sizeof(struct session_config) ? size : sizeof(struct session_config));
+
+    switch (config->samples_per_second) {
+        case 10: case 25: case 50: case 100: break;
+        default: return E_AM_INVALID_CONFIG;
+    }
+    if (config->maximum_time == 0) return E_AM_INVALID_CONFIG;
+    switch (config->encoding) {
+        case AD_ENCODING_PACKED: case AD_ENCODING_ENTROPY: break;
+        case AD_ENCODING_8_BITS: case AD_ENCODING_10_BITS: case AD_ENCODING_12_BITS:
+            if (config->range == 0) return E_AM_INVALID_CONFIG;
+            break;
+        default: return E_AM_INVALID_CONFIG;
+    }
+    // the accelerometer stream is always recorded
+    if (!(config->types & AM_STREAM_ACCELEROMETER)) return E_AM_INVALID_CONFIG;
+    if (config->types & ~(AM_STREAM_ACCELEROMETER | AM_STREAM_HEART_RATE | AM_STREAM_COMPASS)) return E_AM_INVALID_CONFIG;
+    if (config->decimated_below < config->gated_below || config->gated_below < config->features_below) return E_AM_INVALID_CONFIG;
+    if (config->ack_window > AM_MAX_ACK_WINDOW) return E_AM_INVALID_CONFIG;
+    if (config->fec_group > AM_MAX_FEC_GROUP) return E_AM_INVALID_CONFIG;
+    if (config->standby > 1) return E_AM_INVALID_CONFIG;
+
+    return 0;
+}
+
+void am_stop(am_t *context) {
+    if (context == NULL || !context->running) return;
+
+    // no acknowledgement is received after the stop, so the batches waiting for theirs go once more
+    context->ack_window = 0;
+    resend_unacknowledged(context);
 
     uint8_t buffer[1] = {0};
-    send_message(msg_dead, buffer, 1, 0, 0);
+    send_message(msg_dead, &context->streams[0], buffer, 1, 0, 0);
 
-    free(context);
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "am_stop() stopped.");
+    app_timer_cancel(context->time_sync_timer);
+    context->running = false;
+    // the last pipeline tears down the shared handlers, once it has sent its queued messages
+    if (am_active_count() == 0) connection_service_unsubscribe();
+    LG_DEBUG(LG_AM_STOPPED, context->count);
 }
 
 __unused // not really, it's used in main.c
-void am_get_status(char *text, uint16_t max_size) {
-    struct am_context_t *context = app_message_get_context();
-    if (context == NULL) {
+void am_get_status(am_t *context, char *text, uint16_t max_size) {
+    if (context == NULL || !context->running) {
         strncpy(text, "Not recording", max_size);
     } else {
         char error_text[16];
         get_error_text(context->last_error, error_text, 16);
-        snprintf(text, max_size, "C: %ld\nLE: %d %s\nLED: %d\nEC: %d\nUB: %d",
-                 context->count,
+        snprintf(text, max_size, "C: %lu\nLE: %d %s\nLED: %d\nEC: %d\nQ: %d DM: %lu\nUB: %d\nMM: %lu/%d",
+                 (unsigned long)context->count,
                  context->last_error, error_text, context->last_error_distance, context->error_count,
-                 (int)heap_bytes_used());
+                 context->lane.count, (unsigned long)(context->lane.dropped_count + context->control_lane.dropped_count),
+                 (int)heap_bytes_used(), (unsigned long)mm_high_water(), MM_ARENA_SIZE);
     }
 }
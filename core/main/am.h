@@ -8,6 +8,32 @@ extern "C" {
 
 #define APP_MESSAGE_OUTBOX_SIZE APP_MESSAGE_OUTBOX_SIZE_MINIMUM
 
+#define E_AM_INVALID_CONFIG -1
+
+// the stream types in ``struct session_config``
+#define AM_STREAM_ACCELEROMETER 0x01
+#define AM_STREAM_HEART_RATE 0x02
+#define AM_STREAM_COMPASS 0x04
+
+// the largest number of streams sharing the transport, the accelerometer stream included
+#define AM_MAX_STREAMS 3
+
+// the configuration used when the phone does not send one
+#define AM_DEFAULT_SAMPLES_PER_SECOND 50
+#define AM_DEFAULT_MAXIMUM_TIME 1000
+
+// the largest number of sample batches sent and not yet acknowledged by the phone
+#define AM_MAX_ACK_WINDOW 3
+
+// the largest number of sample batches covered by one parity message
+#define AM_MAX_FEC_GROUP 8
+
+/**
+ * The handle of one transport pipeline. The pipelines share the App Messages outbox and the
+ * connection to the phone; each has its own streams, queue and clock synchronisation.
+ */
+typedef struct am_context_t am_t;
+
 typedef enum {
     msg_dead               = 0xdead0000,
     msg_ad                 = 0xad000000,
@@ -15,11 +41,22 @@ typedef enum {
     msg_timed_out          = 0x02000000,
     msg_rejected           = 0x03000000,
     msg_training_completed = 0x04000000,
-    msg_exercise_completed = 0x05000000
+    msg_exercise_completed = 0x05000000,
+    msg_time_sync          = 0x06000000,
+    msg_log                = 0x07000000,
+    msg_parity             = 0x08000000
 } msgkey_t;
 
 /**
- * 5 B in header
+ * 29 B in header. The ``timestamp`` is the time of the first sample in seconds, the
+ * ``sample_interval`` is the time between two samples in 1/256 ms; the time of the n-th
+ * sample is ``timestamp * 1000 + n * sample_interval / 256`` ms. The ``sequence_number``
+ * counts the messages of the session; the phone acknowledges them in ``struct ack_range``.
+ * The ``count`` is the number of values, the samples times the values of one sample. Every
+ * message is one tuple, so the header is all the phone needs to order and size it.
+ * The ``encoding`` is the ``AD_ENCODING_*`` of the samples; a quantised value ``q`` of the
+ * encoding's bits is ``q * range / (2^(encoding - 1) - 1)`` mg.
+ * The ``crc`` is the ``ck_crc16`` of the message without the ``crc``; see ``ck_message_crc(...)``.
  */
 struct __attribute__((__packed__)) header {
     uint8_t preamble1;              // 1
@@ -27,35 +64,180 @@ struct __attribute__((__packed__)) header {
     uint8_t types_count;            // 3
     uint8_t samples_per_second;     // 4
     double timestamp;               // 12
-    uint32_t count;                 // 16
+    uint16_t sample_interval;       // 14
+    uint16_t sequence_number;       // 16
+    uint8_t encoding;               // 17
+    uint16_t range;                 // 19
+    uint32_t count;                 // 23
     // Types
-    uint32_t type;                  // 20
+    uint32_t type;                  // 27
+    uint16_t crc;                   // 29
+};
+
+/**
+ * Session configuration carried in the start and reconfigure commands
+ */
+struct __attribute__((__packed__)) session_config {
+    uint8_t samples_per_second;     // 1
+    uint16_t maximum_time;          // 3
+    uint8_t encoding;               // 4
+    uint8_t types;                  // 5
+    // the battery charge percentages below which the capture is reduced
+    uint8_t decimated_below;        // 6
+    uint8_t gated_below;            // 7
+    uint8_t features_below;         // 8
+    // the number of sample batches sent ahead of the acknowledgements; 0 for no acknowledgements
+    uint8_t ack_window;             // 9
+    // the range in mg of the quantised encodings
+    uint16_t range;                 // 11
+    // the number of sample batches covered by one parity message; 0 for no parity messages
+    uint8_t fec_group;              // 12
+    // 1 for the wake on motion of the accelerometer recording, see ``ad_set_standby(...)``
+    uint8_t standby;                // 13
+};
+
+/**
+ * 5 B ahead of the parity of the ``msg_parity`` message. The parity is the XOR of the ``count``
+ * sample batches, the header and the payload of each, from the ``first`` sequence number on; the
+ * shorter batches are padded with zeros to the longest one. The ``size`` is the XOR of the sizes
+ * of the batches. The XOR of the parity and the received batches of the group is the one lost batch.
+ */
+struct __attribute__((__packed__)) parity_header {
+    uint16_t first;                 // 2
+    uint8_t count;                  // 3
+    uint16_t size;                  // 5
+};
+
+/**
+ * The phone's acknowledgement of the messages with the sequence numbers from ``first`` to ``last``, inclusive
+ */
+struct __attribute__((__packed__)) ack_range {
+    uint16_t first;                 // 2
+    uint16_t last;                  // 4
+};
+
+/**
+ * The phone's reply to the ``msg_time_sync`` ping: the watch time from the ping, the phone
+ * times of receiving the ping and of sending the reply; all in ms since the epoch
+ */
+struct __attribute__((__packed__)) time_sync_reply {
+    int64_t watch_sent;             // 8
+    int64_t phone_received;         // 16
+    int64_t phone_sent;             // 24
 };
 
 ///
-/// Sets up App Messages BLE communication, returning a ``message_callback_t`` value,
-/// which prepends the ``struct header`` above ahead of the samples passed.
+/// Sets up App Messages BLE communication in a free pipeline, returning its handle; the
+/// pipeline's ``am_sink(...)`` prepends the ``struct header`` above ahead of the samples passed.
 /// The ``type``, ``samples_per_second``, and ``sample_size`` will be set in the header.
+/// It also pings the phone every 30 s with ``msg_time_sync`` to synchronise the clocks.
+/// The messages are queued while the phone app is disconnected and sent, oldest first,
+/// when it reconnects; a full queue drops the new sample batch, which the sink reports, and
+/// the oldest control message, or the new one while the oldest is in the outbox. One message is in the outbox
+/// at a time; the outbox sent and failed handlers send the next one, first for the pipelines the busy
+/// outbox turned away, in turns, and then for the pipeline of the last message. A message leaves its queue
+/// once the outbox sent handler confirms it, so the one the outbox failed to send goes again.
+/// The state of every pipeline is reserved in the static arena once and reused by the following calls;
+/// a stopped pipeline still sending its queued messages is taken only when no other is free, and
+/// sends those messages ahead of the new session's.
+/// Returns ``NULL`` if all ``MM_AM_INSTANCES`` pipelines are running or there is no space left in the arena.
 /// - parameter type the type ???
 /// - parameter samples_per_second the actual number of samples per second
 /// - parameter sample_size the size in B of one sample
 ///
-message_callback_t am_start(uint32_t type, uint8_t samples_per_second, uint8_t sample_size);
+am_t *am_start(uint32_t type, uint8_t samples_per_second, uint8_t sample_size);
+
+///
+/// Returns the sink of the samples of the ``type`` given to ``am_start(...)``; its callback is
+/// ``NULL`` if the pipeline is not running.
+///
+struct message_sink am_sink(am_t *am);
+
+///
+/// Updates the ``type``, ``samples_per_second``, ``sample_size`` and ``values`` in the headers of the
+/// messages sent from now on, keeping the running session.
+/// - parameter values the number of values in one sample, counted in the header's ``count``
+///
+void am_reconfigure(am_t *am, uint32_t type, uint8_t samples_per_second, uint8_t sample_size, uint8_t values);
+
+///
+/// Updates the ``encoding`` and ``range`` of the accelerometer stream in the headers of the
+/// messages sent from now on.
+///
+void am_set_encoding(am_t *am, uint8_t encoding, uint16_t range);
+
+///
+/// Adds the stream of ``type`` samples to the running session, returning the ``struct message_sink``
+/// that sends its samples with the stream's ``type`` in the header, so that all streams share
+/// the transport and the synchronised clock. Adding the ``type`` again updates its header fields.
+/// - parameter samples_per_second the number of samples per second, 0 for the samples taken on change
+/// - parameter sample_size the size in B of one sample
+/// - parameter values the number of values in one sample, counted in the header's ``count``
+///
+/// Returns the sink with the ``NULL`` callback if the session is not running or has ``AM_MAX_STREAMS`` streams already
+///
+struct message_sink am_add_stream(am_t *am, uint32_t type, uint8_t samples_per_second, uint8_t sample_size, uint8_t values);
 
 ///
-/// Stops the App Messages communication
+/// Reads the ``config`` from the ``size`` B in ``buffer``. Missing trailing fields
+/// keep their defaults, so that an empty payload gives the default configuration.
+/// The battery thresholds must not increase from ``decimated_below`` to ``features_below``.
 ///
-void am_stop();
+/// Returns 0 for success, ``E_AM_INVALID_CONFIG`` for values that cannot be recorded
+///
+int am_read_config(const uint8_t *buffer, const uint16_t size, struct session_config *config);
+
+///
+/// Receives the ``size`` B of the ``struct time_sync_reply`` to the last ``msg_time_sync``
+/// ping. Once synchronised, the timestamps in the headers are in the phone's time.
+///
+void am_time_sync_received(am_t *am, const uint8_t *buffer, const uint16_t size);
+
+///
+/// Stops the App Messages communication of the ``am`` pipeline, freeing it for ``am_start(...)``.
+/// The messages queued so far are still sent, also when ``am_start(...)`` takes the pipeline again;
+/// no acknowledgement is received after the stop, so the batches waiting for theirs go once more.
+///
+void am_stop(am_t *am);
 
 ///
 /// Returns the status to the given ``text``, having space for ``max_size`` bytes.
 ///
-void am_get_status(char *text, uint16_t max_size);
+void am_get_status(am_t *am, char *text, uint16_t max_size);
+
+///
+/// Sets the number of sample batches sent ahead of the phone's acknowledgements. With a ``window``
+/// greater than 0, the sent batches stay queued until acknowledged, and are sent again if the
+/// acknowledgement does not arrive in time. The ``window`` of 0 sends every batch once.
+///
+void am_set_ack_window(am_t *am, const uint8_t window);
+
+///
+/// Sends the sample batches with the sequence numbers in the ``buffer`` of ``size`` B, each a
+/// ``uint16_t``, again, ahead of the new batches; the phone asks for the batches whose ``crc``
+/// does not match. The sent batches stay in the queue until their slots are needed for new batches,
+/// with or without the acknowledgements of ``am_set_ack_window(...)``; the batches no longer there
+/// are ignored.
+///
+void am_resend_requested(am_t *am, const uint8_t *buffer, const uint16_t size);
+
+///
+/// Sets the number of sample batches covered by one ``msg_parity`` message, sent after the last
+/// batch of every ``group``, so that the phone can reconstruct any one lost batch of the group
+/// without having it sent again. A group ends early at a gap in the sequence numbers, or at the
+/// end of the session. The ``group`` of 0 sends no parity messages.
+///
+void am_set_fec_group(am_t *am, const uint8_t group);
+
+///
+/// Processes the phone's acknowledgement of the sample batches in the ``buffer`` holding ``struct ack_range``.
+///
+void am_ack_received(am_t *am, const uint8_t *buffer, const uint16_t size);
 
 ///
-/// Send a simple message with the key & value
+/// Send a simple message with the key & value. It is sent ahead of the queued sample batches.
 ///
-void am_send_simple(const msgkey_t key, const uint8_t value);
+void am_send_simple(am_t *am, const msgkey_t key, const uint8_t value);
 
 #ifdef __cplusplus
 }
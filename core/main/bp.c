@@ -0,0 +1,68 @@
+#include <pebble.h>
+#include "bp.h"
+#include "lg.h"
+
+/**
+ * Context that holds the thresholds, the selected profile and the handler to call when
+ * the profile changes.
+ */
+static struct {
+    struct bp_thresholds thresholds;
+    bp_profile_t profile;
+    bp_handler_t handler;
+} bp_context;
+
+/**
+ * The profile for ``charge_percent`` with the given extra ``margin`` over the thresholds.
+ */
+static bp_profile_t bp_profile_for(const struct bp_thresholds *thresholds, const int charge_percent, const int margin) {
+    if (charge_percent < thresholds->features_below + margin) return bp_features;
+    if (charge_percent < thresholds->gated_below + margin) return bp_gated;
+    if (charge_percent < thresholds->decimated_below + margin) return bp_decimated;
+    return bp_full;
+}
+
+bp_profile_t bp_select(const struct bp_thresholds *thresholds, const bp_profile_t current, const uint8_t charge_percent, const bool is_charging) {
+    if (is_charging) return bp_full;
+
+    bp_profile_t profile = bp_profile_for(thresholds, charge_percent, 0);
+    // going down is immediate, going up only with the hysteresis
+    if (profile < current) {
+        bp_profile_t up = bp_profile_for(thresholds, charge_percent, BP_HYSTERESIS);
+        return up < current ? up : current;
+    }
+    return profile;
+}
+
+uint8_t bp_reduced_rate(const uint8_t samples_per_second) {
+    switch (samples_per_second) {
+        case 100: return 50;
+        case 50: return 25;
+        default: return 10;
+    }
+}
+
+static void bp_battery_state_handler(BatteryChargeState charge) {
+    bp_profile_t profile = bp_select(&bp_context.thresholds, bp_context.profile, charge.charge_percent, charge.is_charging);
+    if (profile == bp_context.profile) return;
+
+    LG_INFO(LG_BP_PROFILE, charge.charge_percent, bp_context.profile, profile);
+    bp_context.profile = profile;
+    if (bp_context.handler != NULL) bp_context.handler(profile);
+}
+
+void bp_start(const struct bp_thresholds *thresholds, const bp_handler_t handler) {
+    bp_context.thresholds = *thresholds;
+    bp_context.handler = handler;
+
+    BatteryChargeState charge = battery_state_service_peek();
+    bp_context.profile = bp_select(thresholds, bp_full, charge.charge_percent, charge.is_charging);
+    handler(bp_context.profile);
+
+    battery_state_service_subscribe(bp_battery_state_handler);
+}
+
+void bp_stop() {
+    battery_state_service_unsubscribe();
+    bp_context.handler = NULL;
+}
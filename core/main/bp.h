@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// the charge percentages below which the reduced profiles apply, unless configured
+#define BP_DEFAULT_DECIMATED_BELOW 50
+#define BP_DEFAULT_GATED_BELOW 30
+#define BP_DEFAULT_FEATURES_BELOW 15
+// the charge must rise this many percent above a threshold before leaving its profile
+#define BP_HYSTERESIS 5
+
+/**
+ * The capture profiles, from the most to the least energy used
+ */
+typedef enum {
+    // the configured sampling rate, all samples sent
+    bp_full = 0,
+    // half the configured sampling rate, all samples sent
+    bp_decimated = 1,
+    // half the configured sampling rate, only the batches with movement sent
+    bp_gated = 2,
+    // half the configured sampling rate, only the batch features sent
+    bp_features = 3
+} bp_profile_t;
+
+/**
+ * The charge percentages below which the profiles apply
+ */
+struct bp_thresholds {
+    uint8_t decimated_below;
+    uint8_t gated_below;
+    uint8_t features_below;
+};
+
+///
+/// The profile change handler
+///
+typedef void (*bp_handler_t) (const bp_profile_t profile);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Selects the profile for the battery ``charge_percent`` given the ``current`` profile.
+/// A charging watch always gets ``bp_full``; moving to a more generous profile requires
+/// the charge to be ``BP_HYSTERESIS`` above the threshold, so that the profile does not
+/// flip on every battery update around a threshold.
+///
+bp_profile_t bp_select(const struct bp_thresholds *thresholds, const bp_profile_t current, const uint8_t charge_percent, const bool is_charging);
+
+///
+/// Returns the sampling rate of the reduced profiles for the configured ``samples_per_second``.
+///
+uint8_t bp_reduced_rate(const uint8_t samples_per_second);
+
+///
+/// Subscribes to the battery state service, calling the ``handler`` with the profile for
+/// the current charge right away and whenever the profile changes.
+///
+void bp_start(const struct bp_thresholds *thresholds, const bp_handler_t handler);
+
+///
+/// Unsubscribes from the battery state service.
+///
+void bp_stop();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <stdint.h>
+
+// the CRC of no data, to start the CRC of the first block with
+#define CK_CRC16_INIT 0xffff
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Continues the CRC-16/CCITT-FALSE ``crc`` of the preceding blocks with the ``size`` B of ``data``,
+/// one table lookup per B. The CRC of one block starts with ``CK_CRC16_INIT``.
+///
+/// Returns the CRC of the blocks so far
+///
+uint16_t ck_crc16(uint16_t crc, const uint8_t *data, const uint16_t size);
+
+///
+/// Returns the ``crc`` of the ``size`` B of the ``msg_ad`` ``message``: the ``ck_crc16`` of the
+/// ``struct header`` up to its ``crc``, continued with the payload after the header.
+///
+uint16_t ck_message_crc(const uint8_t *message, const uint16_t size);
+
+#ifdef __cplusplus
+}
+#endif
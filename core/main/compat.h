@@ -1,9 +1,16 @@
 #pragma once
+#include "lg.h"
 
 // This is a hack for Pebble, which does not have the __unused definition
 #ifndef __unused
 #define __unused	__attribute__((unused))
 #endif
 
-// This is a hack for Pebble, which does not have the ``void exit(int)`` function.
-#define EXIT(n) { APP_LOG(APP_LOG_LEVEL_ERROR, "exit(%d)", n); APP_LOG(APP_LOG_LEVEL_ERROR, "%d", (n / n-n)); }
+// This is a hack for Pebble, which does not have the ``void exit(int)`` function: the error is logged,
+// and the caller returns.
+#define EXIT(n) do { LG_ERROR(LG_EXIT, n); } while (0)
+
+// This is a hack for the host builds, whose Pebble API has every function of the SDK.
+#ifndef PBL_API_EXISTS
+#define PBL_API_EXISTS(api) true
+#endif
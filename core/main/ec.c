@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include "ec.h"
+#include "ec_table.h"
+
+/**
+ * The bits written most significant bit first
+ */
+struct ec_writer {
+    uint8_t *encoded;
+    uint16_t capacity;
+    uint16_t size;
+    uint32_t accumulator;
+    uint8_t accumulated;
+};
+
+/**
+ * The bits read most significant bit first
+ */
+struct ec_reader {
+    const uint8_t *encoded;
+    uint16_t size;
+    uint32_t position;
+};
+
+/**
+ * Writes the ``length`` low bits of ``bits``; returns false if they do not fit.
+ */
+static bool ec_write(struct ec_writer *writer, const uint32_t bits, const uint8_t length) {
+    writer->accumulator = (writer->accumulator << length) | (bits & ((1u << length) - 1));
+    writer->accumulated += length;
+    while (writer->accumulated >= 8) {
+        if (writer->size == writer->capacity) return false;
+        writer->accumulated -= 8;
+        writer->encoded[writer->size++] = (uint8_t)(writer->accumulator >> writer->accumulated);
+    }
+    return true;
+}
+
+/**
+ * Reads ``length`` bits into ``bits``; returns false past the end of the coded bytes.
+ */
+static bool ec_read(struct ec_reader *reader, const uint8_t length, uint32_t *bits) {
+    *bits = 0;
+    for (uint8_t i = 0; i < length; ++i) {
+        if (reader->position >= (uint32_t)reader->size * 8) return false;
+        uint8_t byte = reader->encoded[reader->position / 8];
+        *bits = (*bits << 1) | ((byte >> (7 - reader->position % 8)) & 1);
+        ++reader->position;
+    }
+    return true;
+}
+
+/**
+ * Writes the ``difference`` as its category code and the category's bits.
+ */
+static bool ec_encode_difference(struct ec_writer *writer, const int16_t difference) {
+    uint16_t magnitude = (uint16_t)(difference < 0 ? -difference : difference);
+    uint8_t category = 0;
+    while (magnitude >> category) ++category;
+
+    if (!ec_write(writer, ec_codes[category], ec_lengths[category])) return false;
+    // the negative differences are stored as difference - 1 in the category's bits, so they start with 0
+    int32_t bits = difference < 0 ? difference + (1 << category) - 1 : difference;
+    return ec_write(writer, (uint32_t)bits, category);
+}
+
+/**
+ * Reads the category code and the category's bits into the ``difference``.
+ */
+static bool ec_decode_difference(struct ec_reader *reader, int16_t *difference) {
+    uint32_t code = 0;
+    for (uint8_t length = 1; length <= 16; ++length) {
+        uint32_t bit;
+        if (!ec_read(reader, 1, &bit)) return false;
+        code = (code << 1) | bit;
+        for (uint8_t category = 0; category < EC_CATEGORIES; ++category) {
+            if (ec_lengths[category] != length || ec_codes[category] != code) continue;
+
+            uint32_t bits;
+            if (!ec_read(reader, category, &bits)) return false;
+            if (category > 0 && bits < (1u << (category - 1))) {
+                *difference = (int16_t)((int32_t)bits - (1 << category) + 1);
+            } else {
+                *difference = (int16_t)bits;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t ec_encode(const struct threed_data *samples, const uint16_t count, uint8_t *encoded, const uint16_t capacity) {
+    struct ec_writer writer = { encoded, capacity, 0, 0, 0 };
+    int16_t previous[3] = { 0, 0, 0 };
+    for (uint16_t i = 0; i < count; ++i) {
+        int16_t values[3] = { samples[i].x_val, samples[i].y_val, samples[i].z_val };
+        for (int j = 0; j < 3; ++j) {
+            if (!ec_encode_difference(&writer, (int16_t)(values[j] - previous[j]))) return 0;
+            previous[j] = values[j];
+        }
+    }
+    // the last bits padded with 0
+    if (writer.accumulated > 0 && !ec_write(&writer, 0, (uint8_t)(8 - writer.accumulated))) return 0;
+
+    return writer.size;
+}
+
+int ec_decode(const uint8_t *encoded, const uint16_t size, struct threed_data *samples, const uint16_t count) {
+    struct ec_reader reader = { encoded, size, 0 };
+    int16_t previous[3] = { 0, 0, 0 };
+    for (uint16_t i = 0; i < count; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            int16_t difference;
+            if (!ec_decode_difference(&reader, &difference)) return E_EC_CORRUPT;
+            previous[j] = (int16_t)(previous[j] + difference);
+        }
+        samples[i].x_val = previous[0];
+        samples[i].y_val = previous[1];
+        samples[i].z_val = previous[2];
+        samples[i]._ = 0;
+    }
+    // no more than the padding left
+    if ((uint32_t)size * 8 - reader.position >= 8) return E_EC_CORRUPT;
+
+    return 0;
+}
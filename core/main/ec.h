@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include "ad.h"
+
+#define E_EC_CORRUPT -1
+
+// the categories of the differences: the number of bits of their magnitude, 0 to 13
+#define EC_CATEGORIES 14
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Entropy-codes the ``count`` ``samples`` into the ``capacity`` B of ``encoded``. Every value is
+/// coded as its difference from the previous sample's value on the same axis: the static Huffman
+/// code of the difference's category, followed by the category's bits of the difference.
+/// The time is linear in ``count``, with at most 13 + 9 bits written per value.
+/// The table in ec_table.h comes from the placeholder histogram of tools/ec_table.py rather than
+/// from recorded sessions: it codes the smooth movements at about 1.7x of the packed samples, the
+/// rest at more, the noise at less; whether a table from the sessions reaches 3-4x is not measured.
+///
+/// Returns the size of the coded samples in B, 0 if they do not fit in ``capacity``
+///
+uint16_t ec_encode(const struct threed_data *samples, const uint16_t count, uint8_t *encoded, const uint16_t capacity);
+
+///
+/// Decodes the ``count`` ``samples`` from the ``size`` B of ``encoded``.
+///
+/// Returns 0 for success, ``E_EC_CORRUPT`` if ``encoded`` does not hold ``count`` coded samples
+///
+int ec_decode(const uint8_t *encoded, const uint16_t size, struct threed_data *samples, const uint16_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+// generated by tools/ec_table.py; do not edit
+// the placeholder category histogram, not measured: 60, 80, 120, 160, 170, 150, 110, 70, 40, 20, 10, 5, 3, 2
+
+// the canonical Huffman codes of the categories of the differences, and their lengths in bits
+static const uint16_t ec_codes[EC_CATEGORIES] = { 0xc, 0xd, 0x2, 0x3, 0x0, 0x4, 0x5, 0xe, 0x1e, 0x3e, 0x7e, 0xfe, 0x1fe, 0x1ff };
+static const uint8_t ec_lengths[EC_CATEGORIES] = { 4, 4, 3, 3, 2, 3, 3, 4, 5, 6, 7, 8, 9, 9 };
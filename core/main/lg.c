@@ -0,0 +1,90 @@
+#include <pebble.h>
+#include <string.h>
+#include "lg.h"
+#include "am.h"
+
+_Static_assert(sizeof(struct lg_record) * LG_RING_LENGTH + 16 <= APP_MESSAGE_OUTBOX_SIZE, "the ring does not fit in one App Message");
+
+/**
+ * The ring of the records, the slot of the next record and the number of records written to it
+ */
+static struct {
+    struct lg_record records[LG_RING_LENGTH];
+    uint16_t next;
+    uint32_t written;
+} lg_ring;
+
+/**
+ * Returns the number of records in the ring.
+ */
+static uint16_t lg_count() {
+    return lg_ring.written < LG_RING_LENGTH ? (uint16_t)lg_ring.written : LG_RING_LENGTH;
+}
+
+/**
+ * Reverses the order of the records in the slots from ``first`` up to ``end``.
+ */
+static void lg_reverse(uint16_t first, uint16_t end) {
+    struct lg_record record;
+    for (; first + 1 < end; ++first, --end) {
+        record = lg_ring.records[first];
+        lg_ring.records[first] = lg_ring.records[end - 1];
+        lg_ring.records[end - 1] = record;
+    }
+}
+
+void lg_write(const uint16_t event, const int32_t a0, const int32_t a1, const int32_t a2) {
+    struct lg_record *record = &lg_ring.records[lg_ring.next];
+    time_t seconds;
+    record->ms = time_ms(&seconds, NULL);
+    record->seconds = (uint32_t)seconds;
+    record->event = event;
+    record->args[0] = a0;
+    record->args[1] = a1;
+    record->args[2] = a2;
+    lg_ring.next = (uint16_t)((lg_ring.next + 1) % LG_RING_LENGTH);
+    ++lg_ring.written;
+}
+
+uint16_t lg_read(uint8_t *buffer, const uint16_t size) {
+    uint16_t count = lg_count();
+    if (count > size / sizeof(struct lg_record)) count = (uint16_t)(size / sizeof(struct lg_record));
+
+    // the oldest of the last count records
+    uint16_t first = (uint16_t)((lg_ring.next + LG_RING_LENGTH - count) % LG_RING_LENGTH);
+    for (uint16_t i = 0; i < count; ++i) {
+        memcpy(buffer + i * sizeof(struct lg_record), &lg_ring.records[(first + i) % LG_RING_LENGTH], sizeof(struct lg_record));
+    }
+    return (uint16_t)(count * sizeof(struct lg_record));
+}
+
+uint32_t lg_written(void) {
+    return lg_ring.written;
+}
+
+void lg_clear(void) {
+    lg_ring.next = 0;
+    lg_ring.written = 0;
+}
+
+int lg_send(void) {
+    // rotate the full ring in place, the oldest record first, rather than copying it on the stack
+    if (lg_ring.written >= LG_RING_LENGTH && lg_ring.next != 0) {
+        lg_reverse(0, lg_ring.next);
+        lg_reverse(lg_ring.next, LG_RING_LENGTH);
+        lg_reverse(0, LG_RING_LENGTH);
+        lg_ring.next = 0;
+    }
+
+    DictionaryIterator *message;
+    if (app_message_outbox_begin(&message) != APP_MSG_OK) return E_LG_NOT_SENT;
+    if (dict_write_data(message, msg_log, (const uint8_t *)lg_ring.records, lg_count() * sizeof(struct lg_record)) != DICT_OK) {
+        return E_LG_NOT_SENT;
+    }
+    dict_write_end(message);
+    // no pipeline of am sent the message
+    app_message_set_context(NULL);
+    if (app_message_outbox_send() != APP_MSG_OK) return E_LG_NOT_SENT;
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <stdint.h>
+
+#define E_LG_NOT_SENT -1
+
+// the levels of the log events
+#define LG_LEVEL_NONE 0
+#define LG_LEVEL_ERROR 1
+#define LG_LEVEL_WARNING 2
+#define LG_LEVEL_INFO 3
+#define LG_LEVEL_DEBUG 4
+
+// the events above this level are compiled out: none of them in the debug builds, all but the errors otherwise
+#ifndef LG_LEVEL
+#ifdef DEBUG
+#define LG_LEVEL LG_LEVEL_DEBUG
+#else
+#define LG_LEVEL LG_LEVEL_ERROR
+#endif
+#endif
+
+// the number of records in the ring, all of them fit in one App Message; the oldest records are overwritten
+#ifndef LG_RING_LENGTH
+#define LG_RING_LENGTH 24
+#endif
+
+// the arguments of one record
+#define LG_ARGS 3
+
+/**
+ * The events of the log, expanded by the given ``LG_EVENT(id, format)``. The watch code keeps the
+ * ids only; the host formats the records with the ``printf`` formats of the ``int32_t`` arguments.
+ * The records carry the ids, so the new events go at the end.
+ */
+#define LG_EVENTS(LG_EVENT) \
+    LG_EVENT(LG_NONE,                  "") \
+    LG_EVENT(LG_EXIT,                  "exit(%d)") \
+    LG_EVENT(LG_AD_NOT_SUBMITTED,      "ad: not kept by the sink, dropped %d samples") \
+    LG_EVENT(LG_AM_DROPPED,            "am: queue full, dropped a message, %d so far") \
+    LG_EVENT(LG_AM_SENT,               "am: sent %08x, %d B") \
+    LG_EVENT(LG_AM_NOT_SENT,           "am: not sent, error %d, %d B, %d failures") \
+    LG_EVENT(LG_AM_SENDING_STOPPED,    "am: stopped sending after %d failures") \
+    LG_EVENT(LG_AM_RESENDING,          "am: acknowledgements timed out, sending %d batches again") \
+    LG_EVENT(LG_AM_TOO_LARGE,          "am: needed %d, had %d B") \
+    LG_EVENT(LG_AM_TIME_SYNC_NOT_SENT, "am: time sync not sent, error %d") \
+    LG_EVENT(LG_AM_TIME_SYNC_IGNORED,  "am: ignoring impossible time sync") \
+    LG_EVENT(LG_AM_FAILURES_RESET,     "am: message sent, %d failures forgotten") \
+    LG_EVENT(LG_AM_CONNECTION,         "am: connected %d, %d queued") \
+    LG_EVENT(LG_AM_NO_SPACE,           "am: no space in the arena") \
+    LG_EVENT(LG_AM_ALL_RUNNING,        "am: all %d pipelines running") \
+    LG_EVENT(LG_AM_STOPPED,            "am: stopped after %d messages") \
+    LG_EVENT(LG_BP_PROFILE,            "bp: %d%% charge, profile %d -> %d") \
+    LG_EVENT(LG_MAIN_RECEIVED,         "main: received %08x") \
+    LG_EVENT(LG_AM_RESEND_REQUESTED,   "am: batch %d requested again") \
+    LG_EVENT(LG_AD_STANDBY,            "ad: standby %d")
+
+#define LG_EVENT_ID(id, format) id,
+typedef enum {
+    LG_EVENTS(LG_EVENT_ID)
+    LG_EVENT_COUNT
+} lg_event_t;
+#undef LG_EVENT_ID
+
+/**
+ * Packed 20 B of one event: the watch time, the event and its arguments, unused ones 0
+ */
+struct __attribute__((__packed__)) lg_record {
+    uint32_t seconds;
+    uint16_t ms;
+    uint16_t event;
+    int32_t args[LG_ARGS];
+};
+
+// the log macros of the levels take the event and up to LG_ARGS arguments
+#define LG_WRITE(event, a0, a1, a2, ...) lg_write(event, (int32_t)(a0), (int32_t)(a1), (int32_t)(a2))
+
+// the compiled out events do not evaluate their arguments, but count as their use
+#define LG_UNUSED(...) do { (void)sizeof((LG_WRITE(__VA_ARGS__, 0, 0, 0, 0), 0)); } while (0)
+
+#if LG_LEVEL >= LG_LEVEL_ERROR
+#define LG_ERROR(...) LG_WRITE(__VA_ARGS__, 0, 0, 0, 0)
+#else
+#define LG_ERROR(...) LG_UNUSED(__VA_ARGS__)
+#endif
+
+#if LG_LEVEL >= LG_LEVEL_WARNING
+#define LG_WARNING(...) LG_WRITE(__VA_ARGS__, 0, 0, 0, 0)
+#else
+#define LG_WARNING(...) LG_UNUSED(__VA_ARGS__)
+#endif
+
+#if LG_LEVEL >= LG_LEVEL_INFO
+#define LG_INFO(...) LG_WRITE(__VA_ARGS__, 0, 0, 0, 0)
+#else
+#define LG_INFO(...) LG_UNUSED(__VA_ARGS__)
+#endif
+
+#if LG_LEVEL >= LG_LEVEL_DEBUG
+#define LG_DEBUG(...) LG_WRITE(__VA_ARGS__, 0, 0, 0, 0)
+#else
+#define LG_DEBUG(...) LG_UNUSED(__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Writes the ``event`` with its arguments to the ring, with the current watch time. Nothing is
+/// formatted on the watch; use the ``LG_*`` macros of the levels rather than calling it directly.
+///
+void lg_write(const uint16_t event, const int32_t a0, const int32_t a1, const int32_t a2);
+
+///
+/// Copies the ``struct lg_record``s in the ring, the oldest first, to the ``size`` B of ``buffer``.
+///
+/// Returns the number of B copied
+///
+uint16_t lg_read(uint8_t *buffer, const uint16_t size);
+
+///
+/// Returns the number of records written since the start, also those overwritten since.
+///
+uint32_t lg_written(void);
+
+///
+/// Empties the ring.
+///
+void lg_clear(void);
+
+///
+/// Sends the records in the ring to the phone in one ``msg_log`` App Message. It puts the message
+/// in the outbox itself, outside the queues of am, so it must not be called while an am pipeline is
+/// running; the outbox handlers of am give the outbox it frees to the pipelines it turned away.
+///
+/// Returns 0 on success, ``E_LG_NOT_SENT`` if the outbox is busy or the phone is not connected
+///
+int lg_send(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,21 @@
 #pragma once
+#include <stdbool.h>
+#include <stdint.h>
 
 ///
-/// ???
+/// Receives ``size`` B of packed samples in ``buffer``. The first sample was taken at
+/// ``timestamp`` (in seconds since the epoch, with millisecond precision), the following
+/// samples every ``sample_interval`` (in 1/256 ms). The ``context`` is the one of the
+/// ``struct message_sink`` that holds the callback.
+/// Returns ``false`` if the buffer could not be kept, for example because the queue of the
+/// transport is full, so that the sender can count the lost samples.
 ///
-typedef void (*message_callback_t) (const uint8_t* buffer, const uint16_t size, const double timestamp, const uint16_t duration);
+typedef bool (*message_callback_t) (void *context, const uint8_t* buffer, const uint16_t size, const double timestamp, const uint16_t sample_interval);
+
+///
+/// The receiver of the buffers of one pipeline: the ``callback`` and its ``context``
+///
+struct message_sink {
+    message_callback_t callback;
+    void *context;
+};
@@ -0,0 +1,21 @@
+#include "mm.h"
+#include <string.h>
+
+static uint8_t mm_arena[MM_ARENA_SIZE] __attribute__((aligned(8)));
+static uint32_t mm_position;
+
+void *mm_reserve(const uint16_t size) {
+    // keep the 8 B alignment of the following reservations
+    uint32_t aligned_size = (uint32_t)((size + 7) & ~7);
+    if (aligned_size > MM_ARENA_SIZE - mm_position) return NULL;
+
+    void *result = mm_arena + mm_position;
+    mm_position += aligned_size;
+    memset(result, 0, aligned_size);
+
+    return result;
+}
+
+uint32_t mm_high_water() {
+    return mm_position;
+}
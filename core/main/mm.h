@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+// the compile-time budgets of the capture and transport state of one pipeline in B
+#define MM_AD_BUDGET 448
+#define MM_AM_BUDGET 2000
+#define MM_SD_BUDGET 320
+
+// the number of capture and transport pipelines; the host tools that simulate many watches raise them
+#ifndef MM_AD_INSTANCES
+#define MM_AD_INSTANCES 2
+#endif
+#ifndef MM_AM_INSTANCES
+#define MM_AM_INSTANCES 1
+#endif
+
+// the size of the statically reserved arena in B
+#define MM_ARENA_SIZE (MM_AD_BUDGET * MM_AD_INSTANCES + MM_AM_BUDGET * MM_AM_INSTANCES + MM_SD_BUDGET)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Reserves ``size`` B of zeroed memory in the static arena. The memory is never released;
+/// the modules reserve their state once and reuse it for every following session.
+///
+/// Returns the reserved memory, ``NULL`` if the arena has no space left
+///
+void *mm_reserve(const uint16_t size);
+
+///
+/// Returns the high-water mark of the arena: the number of B reserved so far.
+///
+uint32_t mm_high_water();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,164 @@
+#include "compat.h"
+#include <pebble.h>
+#include "sd.h"
+#include "mm.h"
+
+/**
+ * Context of one sensor: the sink and the packed readings waiting to be submitted to it.
+ */
+struct sd_context_t {
+    // the sink of the submitted buffers
+    struct message_sink sink;
+    // the maximum time
+    uint16_t maximum_time;
+    // the position in the buffer
+    uint16_t buffer_position;
+    // the time of the first reading in the buffer
+    uint64_t start_time;
+    // the buffer
+    uint8_t buffer[SD_BUFFER_SIZE];
+};
+
+_Static_assert(sizeof(struct sd_context_t) * SD_SENSOR_COUNT <= MM_SD_BUDGET, "sd contexts exceed their budget");
+
+// the contexts of all sensors, reserved in the arena by the first sd_start(...)
+static struct sd_context_t *sd_contexts;
+
+/**
+ * The watch time in ms since the epoch
+ */
+static uint64_t sd_now() {
+    time_t seconds;
+    uint16_t ms;
+    time_ms(&seconds, &ms);
+    return (uint64_t)seconds * 1000 + ms;
+}
+
+/**
+ * Submit the packed readings to the sink with the time of the first reading.
+ */
+static void sd_submit(struct sd_context_t *context) {
+    uint16_t size = context->buffer_position;
+    context->buffer_position = 0;
+    context->sink.callback(context->sink.context, context->buffer, size, (double)context->start_time / 1000, 0);
+}
+
+/**
+ * Packs the reading of ``value`` taken now, submitting the buffer first if the reading
+ * does not fit in it.
+ */
+static void sd_add(struct sd_context_t *context, const uint16_t value) {
+    if (context->sink.callback == NULL) return;
+
+    uint64_t now = sd_now();
+    // the offsets of the readings in one buffer stay below maximum_time
+    if (context->buffer_position > 0 && now - context->start_time >= context->maximum_time) sd_submit(context);
+    if (context->buffer_position == 0) context->start_time = now;
+
+    struct sensor_data *sd = (struct sensor_data *)(context->buffer + context->buffer_position);
+    sd->offset = (uint16_t)(now - context->start_time);
+    sd->value = value;
+    context->buffer_position += sizeof(struct sensor_data);
+
+    if (SD_BUFFER_SIZE - context->buffer_position < sizeof(struct sensor_data)) sd_submit(context);
+}
+
+#if defined(PBL_HEALTH)
+/**
+ * Handle the heart rate updates of the health service.
+ */
+static void sd_health_handler(HealthEventType event, void __unused *data) {
+    if (event != HealthEventHeartRateUpdate) return;
+
+    HealthValue bpm = health_service_peek_current_value(HealthMetricHeartRateBPM);
+    if (bpm > 0) sd_add(&sd_contexts[SD_SENSOR_HEART_RATE], (uint16_t)bpm);
+}
+#endif
+
+/**
+ * Handle the heading updates of the compass service.
+ */
+static void sd_compass_handler(CompassHeadingData heading) {
+    if (heading.compass_status == CompassStatusDataInvalid) return;
+    // TRIG_MAX_ANGLE is the same heading as 0
+    sd_add(&sd_contexts[SD_SENSOR_COMPASS], (uint16_t)heading.magnetic_heading);
+}
+
+/**
+ * Subscribes to the service of the ``sensor``.
+ */
+static int sd_subscribe(const uint8_t sensor) {
+    switch (sensor) {
+        case SD_SENSOR_HEART_RATE:
+#if defined(PBL_HEALTH)
+            // the firmware without the heart rate API
+            if (!PBL_API_EXISTS(health_service_peek_current_value)) return E_SD_UNSUPPORTED;
+            if (!health_service_events_subscribe(sd_health_handler, NULL)) return E_SD_UNSUPPORTED;
+            // the readings every second rather than the default every ten minutes
+            health_service_set_heart_rate_sample_period(1);
+            return 0;
+#else
+            return E_SD_UNSUPPORTED;
+#endif
+        case SD_SENSOR_COMPASS:
+            // the headings that differ by at least 2 degrees
+            compass_service_set_heading_filter(TRIG_MAX_ANGLE / 180);
+            compass_service_subscribe(sd_compass_handler);
+            return 0;
+        default:
+            return E_SD_INVALID_CONFIG;
+    }
+}
+
+/**
+ * Unsubscribes from the service of the ``sensor``.
+ */
+static void sd_unsubscribe(const uint8_t sensor) {
+    switch (sensor) {
+        case SD_SENSOR_HEART_RATE:
+#if defined(PBL_HEALTH)
+            if (!PBL_API_EXISTS(health_service_peek_current_value)) break;
+            health_service_set_heart_rate_sample_period(0);
+            health_service_events_unsubscribe();
+#endif
+            break;
+        case SD_SENSOR_COMPASS:
+            compass_service_unsubscribe();
+            break;
+    }
+}
+
+int sd_start(const uint8_t sensor, const struct message_sink sink, const uint16_t maximum_time) {
+    if (sensor >= SD_SENSOR_COUNT || sink.callback == NULL || maximum_time == 0) return E_SD_INVALID_CONFIG;
+    if (sd_contexts == NULL) sd_contexts = mm_reserve(sizeof(struct sd_context_t) * SD_SENSOR_COUNT);
+    if (sd_contexts == NULL) return E_SD_MEM;
+
+    struct sd_context_t *context = &sd_contexts[sensor];
+    if (context->sink.callback != NULL) {
+        // the new session's streams may have new sinks; the following buffers span the new time
+        if (context->buffer_position > 0 && (context->sink.callback != sink.callback || context->sink.context != sink.context)) sd_submit(context);
+        context->sink = sink;
+        context->maximum_time = maximum_time;
+        return 0;
+    }
+
+    context->maximum_time = maximum_time;
+    context->buffer_position = 0;
+    int result = sd_subscribe(sensor);
+    if (result != 0) return result;
+    context->sink = sink;
+
+    return 0;
+}
+
+int sd_stop(const uint8_t sensor) {
+    if (sensor >= SD_SENSOR_COUNT || sd_contexts == NULL || sd_contexts[sensor].sink.callback == NULL) return E_SD_NOT_RUNNING;
+
+    struct sd_context_t *context = &sd_contexts[sensor];
+    sd_unsubscribe(sensor);
+    // the last batch is usually only partially filled
+    if (context->buffer_position > 0) sd_submit(context);
+    context->sink.callback = NULL;
+
+    return 1;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "m.h"
+
+// buffer size in B
+#define SD_BUFFER_SIZE (uint16_t) sizeof(struct sensor_data) * 30
+
+#define E_SD_MEM -2
+#define E_SD_NOT_RUNNING -3
+#define E_SD_INVALID_CONFIG -4
+#define E_SD_UNSUPPORTED -5
+
+// the sensors
+#define SD_SENSOR_HEART_RATE 0
+#define SD_SENSOR_COMPASS 1
+#define SD_SENSOR_COUNT 2
+
+// the header types of the submitted buffers
+#define SD_TYPE_HEART_RATE 0x516c6168
+#define SD_TYPE_COMPASS 0x516c6163
+
+/**
+ * Packed 4 B of one sensor reading: the time since the first sample in the buffer in ms, and
+ * the value; the heart rate in BPM or the magnetic heading in ``TRIG_MAX_ANGLE`` units
+ */
+struct __attribute__((__packed__)) sensor_data {
+    uint16_t offset;
+    uint16_t value;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Starts the recording of the ``sensor``, one of the ``SD_SENSOR_*`` values, and submits
+/// the readings to the ``sink`` in buffers spanning at most ``maximum_time`` ms. The sensors report
+/// on change rather than at a fixed rate, so every reading carries its own time; the
+/// ``sample_interval`` passed to the ``sink`` is 0. Starting the recording ``sensor`` again keeps
+/// it recording with the new ``maximum_time``; the readings so far go to the old ``sink`` first
+/// if the ``sink`` changes.
+///
+/// Returns 0 for success, ``E_SD_UNSUPPORTED`` if the watch or its firmware has no such sensor,
+/// other negative values for other failures
+///
+int sd_start(const uint8_t sensor, const struct message_sink sink, const uint16_t maximum_time);
+
+///
+/// Stops the recording of the ``sensor``, submitting the readings of the last, partially
+/// filled, buffer to the sink.
+///
+/// Returns 1 for success, ``E_SD_NOT_RUNNING`` if the ``sensor`` was not recording
+///
+int sd_stop(const uint8_t sensor);
+
+#ifdef __cplusplus
+}
+#endif
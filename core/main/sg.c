@@ -0,0 +1,137 @@
+#include "sg.h"
+
+// the angles in 1/65536 of a turn; a quarter of a turn has SG_QUARTER_STEPS steps in the table
+#define SG_TURN 0x10000
+#define SG_QUARTER_STEPS 64
+// the sweep of SG_SIGNAL_CHIRP in mHz and its period in ms
+#define SG_CHIRP_FROM 500
+#define SG_CHIRP_TO 10000
+#define SG_CHIRP_PERIOD 10000
+// the time between the steps of SG_SIGNAL_STEP in ms
+#define SG_STEP_PERIOD 1000
+// the gravity in mg on z
+#define SG_GRAVITY -1000
+
+/**
+ * The sine of a quarter of a turn scaled to 4096; the same on the watch and the host, unlike the
+ * firmware's sin_lookup
+ */
+static const int16_t sg_sine_table[SG_QUARTER_STEPS + 1] = {
+    0, 101, 201, 301, 401, 501, 601, 700, 799, 897, 995, 1092, 1189,
+    1285, 1380, 1474, 1567, 1660, 1751, 1842, 1931, 2019, 2106, 2191, 2276, 2359,
+    2440, 2520, 2598, 2675, 2751, 2824, 2896, 2967, 3035, 3102, 3166, 3229, 3290,
+    3349, 3406, 3461, 3513, 3564, 3612, 3659, 3703, 3745, 3784, 3822, 3857, 3889,
+    3920, 3948, 3973, 3996, 4017, 4036, 4052, 4065, 4076, 4085, 4091, 4095, 4096
+};
+
+/**
+ * Returns the sine of the angle in 1/65536 of a turn, scaled to 4096, interpolated between
+ * the entries of the table.
+ */
+static int32_t sg_sin(const uint32_t angle) {
+    const uint32_t a = angle % SG_TURN;
+    const uint32_t quarter = a / (SG_TURN / 4);
+    uint32_t offset = a % (SG_TURN / 4);
+    // the second and the fourth quarter run backwards
+    if (quarter % 2 == 1) offset = SG_TURN / 4 - offset;
+
+    const uint32_t step = offset >> 8;
+    const int32_t fraction = (int32_t)(offset & 0xff);
+    int32_t value = sg_sine_table[step];
+    if (step < SG_QUARTER_STEPS) value += ((sg_sine_table[step + 1] - value) * fraction) >> 8;
+    return quarter >= 2 ? -value : value;
+}
+
+/**
+ * Returns the seeded hash of the time t and the axis, spread over all 32 bits.
+ */
+static uint32_t sg_hash(const uint32_t seed, const uint64_t t, const uint32_t axis) {
+    uint32_t h = seed ^ (uint32_t)(t * 3 + axis) * 2654435761u;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * Returns a uniform noise value in ±SG_AMPLITUDE mg.
+ */
+static int16_t sg_noise(const uint32_t seed, const uint64_t t, const uint32_t axis) {
+    return (int16_t)((int32_t)(sg_hash(seed, t, axis) % (2 * SG_AMPLITUDE + 1)) - SG_AMPLITUDE);
+}
+
+/**
+ * Generates the sample of the generator's signal t ms after its start.
+ */
+static void sg_sample(const struct sg_generator *generator, const uint64_t t, AccelRawData *sample) {
+    switch (generator->signal) {
+        case SG_SIGNAL_SINE: {
+            const uint32_t angle = (uint32_t)(t * SG_TURN / 1000);
+            sample->x = (int16_t)(SG_AMPLITUDE * sg_sin(angle) / 4096);
+            sample->y = 0;
+            sample->z = (int16_t)(SG_AMPLITUDE * sg_sin(angle + SG_TURN / 4) / 4096);
+            break;
+        }
+        case SG_SIGNAL_CHIRP: {
+            // the phase is the integral of the frequency rising linearly over the period
+            const uint64_t p = t % SG_CHIRP_PERIOD;
+            const uint64_t turns = SG_CHIRP_FROM * p * 2 * SG_CHIRP_PERIOD + (SG_CHIRP_TO - SG_CHIRP_FROM) * p * p;
+            const uint32_t angle = (uint32_t)(turns * SG_TURN / (2ull * SG_CHIRP_PERIOD * 1000000));
+            sample->x = (int16_t)(SG_AMPLITUDE * sg_sin(angle) / 4096);
+            sample->y = 0;
+            sample->z = SG_GRAVITY;
+            break;
+        }
+        case SG_SIGNAL_STEP:
+            sample->x = (t / SG_STEP_PERIOD) % 2 == 0 ? 0 : SG_AMPLITUDE;
+            sample->y = 0;
+            sample->z = SG_GRAVITY;
+            break;
+        case SG_SIGNAL_NOISE:
+            sample->x = sg_noise(generator->seed, t, 0);
+            sample->y = sg_noise(generator->seed, t, 1);
+            sample->z = (int16_t)(SG_GRAVITY + sg_noise(generator->seed, t, 2));
+            break;
+        case SG_SIGNAL_PATTERN: {
+            const AccelRawData *recorded = &generator->pattern[(t * generator->pattern_rate / 1000) % generator->pattern_length];
+            sample->x = recorded->x;
+            sample->y = recorded->y;
+            sample->z = recorded->z;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+int sg_start(struct sg_generator *generator, const uint8_t signal, const uint32_t seed) {
+    if (signal > SG_SIGNAL_PATTERN) return E_SG_INVALID_SIGNAL;
+    if (signal == SG_SIGNAL_PATTERN && (generator->pattern_length == 0 || generator->pattern_rate == 0)) return E_SG_INVALID_SIGNAL;
+
+    generator->signal = signal;
+    generator->seed = seed;
+    generator->started = false;
+    return 0;
+}
+
+void sg_set_pattern(struct sg_generator *generator, const AccelRawData *samples, const uint16_t count, const uint8_t samples_per_second) {
+    generator->pattern = samples;
+    generator->pattern_length = samples == NULL ? 0 : count;
+    generator->pattern_rate = samples_per_second;
+    if (generator->signal == SG_SIGNAL_PATTERN && generator->pattern_length == 0) generator->signal = SG_SIGNAL_NONE;
+}
+
+void sg_fill(struct sg_generator *generator, AccelRawData *data, const uint32_t count, const uint64_t timestamp, const uint16_t sample_interval) {
+    if (generator->signal == SG_SIGNAL_NONE) return;
+
+    if (!generator->started) {
+        generator->origin = timestamp;
+        generator->started = true;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint64_t time = timestamp + ((i * (uint64_t)sample_interval) >> 8);
+        sg_sample(generator, time < generator->origin ? 0 : time - generator->origin, &data[i]);
+    }
+}
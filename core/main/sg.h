@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// the signals of the generator: the accelerometer's own samples, a circle of 1 Hz in the x-z
+// plane, a sweep from 0.5 to 10 Hz on x every 10 s, a step of x every 1 s, uniform noise on
+// all axes, and the samples of a recorded pattern over and over
+#define SG_SIGNAL_NONE 0
+#define SG_SIGNAL_SINE 1
+#define SG_SIGNAL_CHIRP 2
+#define SG_SIGNAL_STEP 3
+#define SG_SIGNAL_NOISE 4
+#define SG_SIGNAL_PATTERN 5
+
+#define E_SG_INVALID_SIGNAL -1
+
+// the amplitude of the generated movement in mg; the gravity stays on z
+#define SG_AMPLITUDE 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the AccelRawData of the generated samples
+#include <pebble.h>
+
+/**
+ * One generator of synthetic samples. The samples are a function of their time since the first
+ * generated sample and of the ``seed``, so that the same calls give the same samples every run.
+ */
+struct sg_generator {
+    // the SG_SIGNAL_* of the samples
+    uint8_t signal;
+    // the seed of the noise
+    uint32_t seed;
+    // the time in ms of the first generated sample, once started
+    bool started;
+    uint64_t origin;
+    // the recorded samples of SG_SIGNAL_PATTERN, taken at pattern_rate samples per second
+    const AccelRawData *pattern;
+    uint16_t pattern_length;
+    uint8_t pattern_rate;
+};
+
+///
+/// Starts the ``generator`` with the ``signal``, one of the ``SG_SIGNAL_*`` values, and the ``seed``
+/// of the noise; the time of the next generated sample is the start of the signal. The generator
+/// keeps its pattern.
+///
+/// Returns 0 for success, ``E_SG_INVALID_SIGNAL`` for an unknown signal or a pattern without samples
+///
+int sg_start(struct sg_generator *generator, const uint8_t signal, const uint32_t seed);
+
+///
+/// Sets the ``count`` ``samples`` taken at ``samples_per_second`` that ``SG_SIGNAL_PATTERN`` plays
+/// over and over. The ``samples``, loaded from a resource by the app, or recorded by the host
+/// tools, must outlive their use by the ``generator``.
+///
+void sg_set_pattern(struct sg_generator *generator, const AccelRawData *samples, const uint16_t count, const uint8_t samples_per_second);
+
+///
+/// Replaces the ``count`` samples of ``data`` with those of the ``generator``'s signal; the first one
+/// is at ``timestamp`` ms, the following ones ``sample_interval`` 1/256 ms apart. With
+/// ``SG_SIGNAL_NONE``, the ``data`` stays as it is.
+///
+void sg_fill(struct sg_generator *generator, AccelRawData *data, const uint32_t count, const uint64_t timestamp, const uint16_t sample_interval);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,66 @@
+#include "ts.h"
+#include <stddef.h>
+
+void ts_reset(struct ts_state *state) {
+    state->count = 0;
+    state->next = 0;
+    state->reference_time = 0;
+    state->offset = 0;
+    state->drift = 0;
+}
+
+/**
+ * The exchange with the smallest delay among the exchanges ``from`` (inclusive) to ``to``
+ * (exclusive), counting from the oldest exchange in the window.
+ */
+static const struct ts_exchange *ts_best(const struct ts_state *state, const uint8_t from, const uint8_t to) {
+    uint8_t oldest = state->count < TS_WINDOW ? 0 : state->next;
+    const struct ts_exchange *best = NULL;
+    for (uint8_t i = from; i < to; ++i) {
+        const struct ts_exchange *exchange = &state->exchanges[(oldest + i) % TS_WINDOW];
+        if (best == NULL || exchange->delay < best->delay) best = exchange;
+    }
+    return best;
+}
+
+int ts_add(struct ts_state *state, const int64_t t1, const int64_t t2, const int64_t t3, const int64_t t4) {
+    if (t4 < t1 || t3 < t2) return E_TS_INVALID;
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    if (delay < 0) return E_TS_INVALID;
+
+    struct ts_exchange *exchange = &state->exchanges[state->next];
+    exchange->time = t4;
+    exchange->offset = ((t2 - t1) + (t3 - t4)) / 2;
+    exchange->delay = delay;
+    state->next = (uint8_t)((state->next + 1) % TS_WINDOW);
+    if (state->count < TS_WINDOW) ++state->count;
+
+    const struct ts_exchange *best = ts_best(state, 0, state->count);
+    state->reference_time = best->time;
+    state->offset = best->offset;
+    state->drift = 0;
+
+    if (state->count >= 4) {
+        const struct ts_exchange *older = ts_best(state, 0, state->count / 2);
+        const struct ts_exchange *newer = ts_best(state, state->count / 2, state->count);
+        if (newer->time > older->time) {
+            int64_t drift = (newer->offset - older->offset) * 1000000 / (newer->time - older->time);
+            if (drift >= -TS_MAX_DRIFT && drift <= TS_MAX_DRIFT) {
+                state->drift = (int32_t)drift;
+                state->reference_time = newer->time;
+                state->offset = newer->offset;
+            }
+        }
+    }
+
+    return 0;
+}
+
+bool ts_synchronised(const struct ts_state *state) {
+    return state->count > 0;
+}
+
+int64_t ts_phone_time(const struct ts_state *state, const int64_t watch_time) {
+    if (!ts_synchronised(state)) return watch_time;
+    return watch_time + state->offset + (watch_time - state->reference_time) * state->drift / 1000000;
+}
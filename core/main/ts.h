@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#define E_TS_INVALID -1
+
+// the number of exchanges kept to estimate the offset and drift
+#define TS_WINDOW 8
+// the largest drift between the two clocks that we believe in, in ppm
+#define TS_MAX_DRIFT 500
+
+/**
+ * One ping/pong exchange: the watch time when the pong arrived, the measured
+ * offset of the phone clock and the round-trip delay, all in ms
+ */
+struct ts_exchange {
+    int64_t time;
+    int64_t offset;
+    int64_t delay;
+};
+
+/**
+ * The state of the clock synchronisation with the phone
+ */
+struct ts_state {
+    // the last TS_WINDOW exchanges, oldest at ``next`` once full
+    struct ts_exchange exchanges[TS_WINDOW];
+    uint8_t count;
+    uint8_t next;
+
+    // the watch time of the offset estimate
+    int64_t reference_time;
+    // the phone time - watch time at ``reference_time``
+    int64_t offset;
+    // the phone clock drift relative to the watch clock in ppm
+    int32_t drift;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///
+/// Resets the ``state`` to no synchronisation.
+///
+void ts_reset(struct ts_state *state);
+
+///
+/// Adds one NTP-style exchange: the ping left the watch at ``t1``, arrived at the
+/// phone at ``t2``, the pong left the phone at ``t3`` and arrived at the watch at
+/// ``t4``; all in ms since the epoch of the respective clock. The offset is taken from
+/// the exchange with the smallest round-trip delay in the window; the drift from the
+/// best exchanges of the older and the newer half of the window.
+///
+/// Returns 0 for success, ``E_TS_INVALID`` for exchanges with impossible times
+///
+int ts_add(struct ts_state *state, const int64_t t1, const int64_t t2, const int64_t t3, const int64_t t4);
+
+///
+/// Returns ``true`` if at least one exchange has been added to ``state``.
+///
+bool ts_synchronised(const struct ts_state *state);
+
+///
+/// Converts the ``watch_time`` to the phone time, both in ms since the epoch. Returns the
+/// ``watch_time`` unchanged if the ``state`` is not synchronised.
+///
+int64_t ts_phone_time(const struct ts_state *state, const int64_t watch_time);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "ad.h"
+#include "sg.h"
 #include "mocks.h"
 
 using namespace pebble;
@@ -8,32 +9,64 @@ class ad_test : public testing::Test {
 protected:
     static uint8_t *buffer;
     static uint16_t size;
+    static double timestamp;
+    static uint16_t sample_interval;
+    ad_t *ad;
+    const message_sink sink { ad_callback, nullptr };
 public:
-    static void ad_callback(const uint8_t *b, const uint16_t s, const double, const uint16_t);
+    static bool ad_callback(void *context, const uint8_t *b, const uint16_t s, const double t, const uint16_t i);
 
+    ad_test();
     virtual ~ad_test();
 };
 
+ad_test::ad_test(): ad(ad_open()) {
+}
+
 ad_test::~ad_test() {
+   ad_close(ad);
    if (buffer != nullptr) free(buffer);
+   buffer = nullptr;
+   size = 0;
 }
 
-void ad_test::ad_callback(const uint8_t *b, const uint16_t s, const double, const uint16_t) {
+bool ad_test::ad_callback(void *context, const uint8_t *b, const uint16_t s, const double t, const uint16_t i) {
     if (buffer != nullptr) free(buffer);
     buffer = (uint8_t *)malloc(s);
     memcpy(buffer, b, s);
     size = s;
+    timestamp = t;
+    sample_interval = i;
+    return true;
+}
+
+/// The samples of all buffers submitted to one sink
+struct capture {
+    std::vector<threed_data> samples;
+    double timestamp;
+    uint16_t sample_interval;
+};
+
+static bool capture_callback(void *context, const uint8_t *b, const uint16_t s, const double t, const uint16_t i) {
+    auto c = static_cast<capture *>(context);
+    if (c->samples.empty()) c->timestamp = t;
+    auto samples = reinterpret_cast<const threed_data *>(b);
+    c->samples.insert(c->samples.end(), samples, samples + s / sizeof(threed_data));
+    c->sample_interval = i;
+    return true;
 }
 
 uint8_t *ad_test::buffer;
 uint16_t ad_test::size;
+double ad_test::timestamp;
+uint16_t ad_test::sample_interval;
 
 TEST_F(ad_test, overflows) {
     std::vector<AccelRawData> mock_data;
     AccelRawData a = { .x = 1000, .y = 5000, .z = -5000 };
     for (int i = 0; i < 2; i++) mock_data.push_back(a);
 
-    ad_start(ad_test::ad_callback, 50, 1000);
+    ad_start(ad, sink, 50, 1000);
     for (int i = 0; i < AD_BUFFER_SIZE / 2  / sizeof(threed_data); i++) *mocks::accel_service() << mock_data;
 
     ASSERT_TRUE(ad_test::buffer != nullptr);
@@ -44,6 +77,211 @@ TEST_F(ad_test, overflows) {
         EXPECT_EQ(data[i].z_val, -4095);
     }
 
-    ad_stop();
+    ad_stop(ad);
+
+}
+
+TEST_F(ad_test, reconfigure_submits_buffered_samples) {
+    std::vector<AccelRawData> mock_data;
+    AccelRawData a = { .x = 1, .y = 2, .z = 3 };
+    for (int i = 0; i < AD_NUM_SAMPLES * 2; i++) mock_data.push_back(a);
+
+    EXPECT_EQ(ad_reconfigure(ad, 25, 1000), E_AD_NOT_RUNNING);
+    ad_start(ad, sink, 50, 1000);
+    *mocks::accel_service() << mock_data;
+    EXPECT_TRUE(ad_test::buffer == nullptr);
+
+    EXPECT_EQ(ad_reconfigure(ad, 30, 1000), E_AD_INVALID_CONFIG);
+    EXPECT_EQ(ad_reconfigure(ad, 25, 1000), 0);
+    ASSERT_TRUE(ad_test::buffer != nullptr);
+    EXPECT_EQ(ad_test::size, AD_NUM_SAMPLES * 2 * sizeof(threed_data));
+
+    ad_stop(ad);
+}
+
+TEST_F(ad_test, stop_submits_partial_buffer) {
+    std::vector<AccelRawData> mock_data;
+    AccelRawData a = { .x = 1, .y = 2, .z = 3 };
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(a);
+
+    EXPECT_EQ(ad_stop(ad), E_AD_NOT_RUNNING);
+    ad_start(ad, sink, 50, 1000);
+    *mocks::accel_service() << mock_data;
+    EXPECT_TRUE(ad_test::buffer == nullptr);
+
+    ad_stop(ad);
+    ASSERT_TRUE(ad_test::buffer != nullptr);
+    EXPECT_EQ(ad_test::size, AD_NUM_SAMPLES * sizeof(threed_data));
+
+    // restarting reuses the buffer, which starts empty
+    ad_start(ad, sink, 50, 1000);
+    *mocks::accel_service() << mock_data;
+    ad_stop(ad);
+    EXPECT_EQ(ad_test::size, AD_NUM_SAMPLES * sizeof(threed_data));
+}
+
+TEST_F(ad_test, odd_sample_counts) {
+    std::vector<AccelRawData> mock_data;
+    for (int i = 0; i < 15; i++) {
+        AccelRawData a = { .x = (int16_t)i, .y = 0, .z = 0 };
+        mock_data.push_back(a);
+    }
+
+    ad_start(ad, sink, 50, 60000);
+    for (int i = 0; i < 4; i++) *mocks::accel_service() << mock_data;
+
+    // 60 samples fill one buffer, the remaining 10 samples start the next one
+    ASSERT_TRUE(ad_test::buffer != nullptr);
+    EXPECT_EQ(ad_test::size, AD_BUFFER_SIZE);
+    threed_data *data = reinterpret_cast<threed_data *>(ad_test::buffer);
+    for (int i = 0; i < AD_BUFFER_SIZE / sizeof(threed_data); i++) EXPECT_EQ(data[i].x_val, i % 15);
+
+    ad_stop(ad);
+    EXPECT_EQ(ad_test::size, 10 * sizeof(threed_data));
+    EXPECT_EQ(ad_get_dropped_samples(ad), 0);
+}
+
+/// Keeps every other buffer, as a transport with a full queue would
+static bool refusing_callback(void *context, const uint8_t *b, const uint16_t s, const double t, const uint16_t i) {
+    return ++*static_cast<int *>(context) % 2 == 0;
+}
+
+TEST_F(ad_test, dropped_samples) {
+    std::vector<AccelRawData> mock_data(AD_NUM_SAMPLES, AccelRawData { 1, 2, 3 });
+    int buffers = 0;
+
+    // one buffer of every update
+    ad_start(ad, message_sink { refusing_callback, &buffers }, 50, 200);
+    for (int i = 0; i < 4; i++) *mocks::accel_service() << mock_data;
+    EXPECT_EQ(buffers, 4);
+    EXPECT_EQ(ad_get_dropped_samples(ad), 2 * AD_NUM_SAMPLES);
+
+    // the features of the refused buffers count their samples
+    ASSERT_EQ(ad_set_mode(ad, AD_MODE_FEATURES), 0);
+    *mocks::accel_service() << mock_data;
+    EXPECT_EQ(ad_get_dropped_samples(ad), 3 * AD_NUM_SAMPLES);
+    ad_stop(ad);
+
+    // counted from the start of the recording
+    ad_start(ad, message_sink { refusing_callback, &buffers }, 50, 1000);
+    EXPECT_EQ(ad_get_dropped_samples(ad), 0);
+    ad_stop(ad);
+}
+
+TEST_F(ad_test, sample_interval) {
+    std::vector<AccelRawData> mock_data;
+    AccelRawData a = { .x = 1, .y = 2, .z = 3 };
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(a);
+
+    ad_start(ad, sink, 50, 1000);
+    for (int i = 0; i < 3; i++) *mocks::accel_service() << mock_data;
+    ad_stop(ad);
+
+    // all samples are 20 ms apart
+    ASSERT_TRUE(ad_test::buffer != nullptr);
+    EXPECT_EQ(ad_test::size, 3 * AD_NUM_SAMPLES * sizeof(threed_data));
+    EXPECT_EQ(ad_test::sample_interval, 20 << 8);
+}
+
+TEST_F(ad_test, quantised_encoding) {
+    std::vector<AccelRawData> mock_data;
+    AccelRawData a = { .x = 1000, .y = -4000, .z = 5000 };
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(a);
+
+    ad_start(ad, sink, 50, 1000);
+    EXPECT_EQ(ad_set_encoding(ad, 7, 4000), E_AD_INVALID_CONFIG);
+    EXPECT_EQ(ad_set_encoding(ad, AD_ENCODING_8_BITS, 0), E_AD_INVALID_CONFIG);
+    EXPECT_EQ(ad_set_encoding(ad, AD_ENCODING_8_BITS, 4000), 0);
+    *mocks::accel_service() << mock_data;
+    ad_stop(ad);
+
+    // 3 B per sample: 1000 mg is 32 of 127 levels over ±4000 mg; the clamped 4095 mg is 127
+    ASSERT_TRUE(ad_test::buffer != nullptr);
+    ASSERT_EQ(ad_test::size, AD_NUM_SAMPLES * 3);
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) {
+        EXPECT_EQ((int8_t)ad_test::buffer[i * 3], 32);
+        EXPECT_EQ((int8_t)ad_test::buffer[i * 3 + 1], -127);
+        EXPECT_EQ((int8_t)ad_test::buffer[i * 3 + 2], 127);
+    }
+}
+
+TEST_F(ad_test, pipelines_share_the_service) {
+    std::vector<AccelRawData> mock_data;
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(AccelRawData { (int16_t)i, 0, 0 });
+
+    capture fast, slow;
+    ad_t *second = ad_open();
+    ASSERT_TRUE(second != nullptr);
+    EXPECT_EQ(ad_start(ad, message_sink { capture_callback, &fast }, 50, 1000), 1);
+    EXPECT_EQ(ad_start(second, message_sink { capture_callback, &slow }, 25, 1000), 1);
+    // the service cannot sample at 25 Hz and 10 Hz at the same time
+    EXPECT_EQ(ad_reconfigure(ad, 10, 1000), E_AD_INVALID_CONFIG);
+
+    for (int i = 0; i < 3; i++) *mocks::accel_service() << mock_data;
+    ad_close(second);
+    ad_stop(ad);
+
+    // the 25 Hz pipeline keeps every other sample of the 50 Hz service
+    ASSERT_EQ(fast.samples.size(), 3 * AD_NUM_SAMPLES);
+    ASSERT_EQ(slow.samples.size(), 3 * AD_NUM_SAMPLES / 2);
+    for (size_t i = 0; i < slow.samples.size(); i++) EXPECT_EQ(slow.samples[i].x_val, (2 * i) % AD_NUM_SAMPLES);
+    EXPECT_DOUBLE_EQ(slow.timestamp, fast.timestamp);
+    EXPECT_EQ(fast.sample_interval, 20 << 8);
+    EXPECT_EQ(slow.sample_interval, 40 << 8);
+}
+
+TEST_F(ad_test, synthetic_signal) {
+    std::vector<AccelRawData> mock_data(AD_NUM_SAMPLES, AccelRawData { 7, 7, 7 });
+    capture captured;
+    EXPECT_EQ(ad_set_signal(SG_SIGNAL_PATTERN + 1), E_AD_INVALID_CONFIG);
+    // the watch has no pattern to play
+    EXPECT_EQ(ad_set_signal(SG_SIGNAL_PATTERN), E_AD_INVALID_CONFIG);
+    ASSERT_EQ(ad_set_signal(SG_SIGNAL_STEP), 0);
+    ad_start(ad, message_sink { capture_callback, &captured }, 50, 1000);
+    for (int i = 0; i < 12; ++i) *mocks::accel_service() << mock_data;
+    ad_stop(ad);
+    ASSERT_EQ(ad_set_signal(SG_SIGNAL_NONE), 0);
+
+    // the samples of the step instead of those of the service
+    ASSERT_EQ(captured.samples.size(), 12 * AD_NUM_SAMPLES);
+    EXPECT_EQ(captured.samples[0].x_val, 0);
+    EXPECT_EQ(captured.samples[0].z_val, -1000);
+    EXPECT_EQ(captured.samples[49].x_val, 0);
+    EXPECT_EQ(captured.samples[50].x_val, SG_AMPLITUDE);
+    EXPECT_EQ(captured.samples[119].x_val, 0);
+}
+
+/// The number of samples and the sample interval of every buffer submitted to one sink
+static bool buffers_callback(void *context, const uint8_t *b, const uint16_t s, const double t, const uint16_t i) {
+    static_cast<std::vector<std::pair<size_t, uint16_t>> *>(context)->push_back(std::make_pair(s / sizeof(threed_data), i));
+    return true;
+}
+
+TEST_F(ad_test, standby_wakes_on_motion) {
+    std::vector<AccelRawData> still(AD_NUM_SAMPLES, AccelRawData { 0, 0, -1000 });
+    std::vector<AccelRawData> moving;
+    for (int i = 0; i < AD_NUM_SAMPLES; ++i) moving.push_back(AccelRawData { (int16_t)(i % 2 == 0 ? 800 : -800), 0, -1000 });
+    std::vector<std::pair<size_t, uint16_t>> buffers;
+
+    EXPECT_EQ(ad_set_standby(ad, true), E_AD_NOT_RUNNING);
+    ad_start(ad, message_sink { buffers_callback, &buffers }, 50, 1000);
+    ASSERT_EQ(ad_set_standby(ad, true), 0);
+    for (int i = 0; i < 3; ++i) *mocks::accel_service() << still;
+    EXPECT_TRUE(buffers.empty());
+
+    // the pre-roll of the last 2 s at the standby rate, the movement included
+    *mocks::accel_service() << moving;
+    ASSERT_EQ(buffers.size(), 1);
+    EXPECT_EQ(buffers[0].first, AD_PREROLL_LENGTH);
+    EXPECT_EQ(buffers[0].second, (1000 << 8) / AD_STANDBY_RATE);
+
+    // the recording at its own frequency until 10 s without movement
+    for (int i = 0; i < 60; ++i) *mocks::accel_service() << still;
+    ASSERT_EQ(buffers.size(), 11);
+    EXPECT_EQ(buffers[1].first, 50);
+    EXPECT_EQ(buffers[1].second, 20 << 8);
+    for (int i = 0; i < 10; ++i) *mocks::accel_service() << still;
+    EXPECT_EQ(buffers.size(), 11);
 
+    ad_stop(ad);
 }
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "am.h"
 #include "ad.h"
+#include "mm.h"
+#include "ck.h"
 #include "mocks.h"
 
 class am_test : public testing::Test {
@@ -50,14 +52,15 @@ protected:
 };
 
 TEST_F(am_test, trivial) {
-    auto callback = am_start(123, 100, 2);
+    auto am = am_start(123, 100, 2);
+    auto sink = am_sink(am);
     uint8_t buf[] = {1, 1, 2, 2, 3, 3};
-    callback(buf, 6, 0, 0);
+    sink.callback(sink.context, buf, 6, 0, 0);
     auto data = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(0xad000000);
-    bytes_equal(data, { 0x61, 0x65, 0x01, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03 });
-    am_stop();
+    bytes_equal(data, { 0x61, 0x65, 0x01, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00, 0x00, 0x31, 0x01, 0x01, 0x02, 0x02, 0x03, 0x03 });
+    am_stop(am);
     data = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(0xdead0000);
-    bytes_equal(data, { 0x61, 0x65, 0x01, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00, 0x00 });
+    bytes_equal(data, { 0x61, 0x65, 0x01, 0x64, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7b, 0x00, 0x00, 0x00, 0x6f, 0x53, 0x00 });
 }
 
 TEST_F(am_test, accelerometer_data) {
@@ -70,34 +73,320 @@ TEST_F(am_test, accelerometer_data) {
         accelerometer[i].z_val = 1;
     }
 
-    auto callback = am_start(123, 50, 5);
-    callback(reinterpret_cast<uint8_t *>(accelerometer), sizeof(accelerometer), 0, 1000);
+    auto am = am_start(123, 50, 5);
+    auto sink = am_sink(am);
+    sink.callback(sink.context, reinterpret_cast<uint8_t *>(accelerometer), sizeof(accelerometer), 0, 20 << 8);
     auto data = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(0xad000000);
     EXPECT_EQ(data.size(), COUNT * sizeof(threed_data) + sizeof(header));
     cout_bytes(data);
+    am_stop(am);
 }
 
-/*
+TEST_F(am_test, read_config) {
+    session_config config;
+    EXPECT_EQ(am_read_config(nullptr, 0, &config), 0);
+    EXPECT_EQ(config.samples_per_second, AM_DEFAULT_SAMPLES_PER_SECOND);
+    EXPECT_EQ(config.maximum_time, AM_DEFAULT_MAXIMUM_TIME);
+    EXPECT_EQ(config.encoding, AD_ENCODING_PACKED);
+    EXPECT_EQ(config.types, AM_STREAM_ACCELEROMETER);
 
-This is only applicable with queueing AM
+    uint8_t rate_only[] = { 100 };
+    EXPECT_EQ(am_read_config(rate_only, sizeof(rate_only), &config), 0);
+    EXPECT_EQ(config.samples_per_second, 100);
+    EXPECT_EQ(config.maximum_time, AM_DEFAULT_MAXIMUM_TIME);
 
-TEST_F(am_test, timeout_on_send) {
-    auto callback = am_start(123, 100, 1);
+    uint8_t full[] = { 25, 0xf4, 0x01, AD_ENCODING_PACKED, AM_STREAM_ACCELEROMETER };
+    EXPECT_EQ(am_read_config(full, sizeof(full), &config), 0);
+    EXPECT_EQ(config.samples_per_second, 25);
+    EXPECT_EQ(config.maximum_time, 500);
+
+    uint8_t bad_rate[] = { 30 };
+    EXPECT_EQ(am_read_config(bad_rate, sizeof(bad_rate), &config), E_AM_INVALID_CONFIG);
+    uint8_t bad_encoding[] = { 50, 0xe8, 0x03, 7 };
+    EXPECT_EQ(am_read_config(bad_encoding, sizeof(bad_encoding), &config), E_AM_INVALID_CONFIG);
+    uint8_t bad_window[] = { 50, 0xe8, 0x03, AD_ENCODING_PACKED, AM_STREAM_ACCELEROMETER, 50, 30, 15, AM_MAX_ACK_WINDOW + 1 };
+    EXPECT_EQ(am_read_config(bad_window, sizeof(bad_window), &config), E_AM_INVALID_CONFIG);
+    uint8_t bad_group[] = { 50, 0xe8, 0x03, AD_ENCODING_PACKED, AM_STREAM_ACCELEROMETER, 50, 30, 15, 0, 0x00, 0x04, AM_MAX_FEC_GROUP + 1 };
+    EXPECT_EQ(am_read_config(bad_group, sizeof(bad_group), &config), E_AM_INVALID_CONFIG);
+    uint8_t standby[] = { 50, 0xe8, 0x03, AD_ENCODING_PACKED, AM_STREAM_ACCELEROMETER, 50, 30, 15, 0, 0xa0, 0x0f, 0, 1 };
+    EXPECT_EQ(am_read_config(standby, sizeof(standby), &config), 0);
+    EXPECT_EQ(config.standby, 1);
+}
+
+TEST_F(am_test, reuses_arena) {
+    auto am = am_start(123, 50, 5);
+    ASSERT_TRUE(am != nullptr);
+    uint32_t high_water = mm_high_water();
+    EXPECT_GT(high_water, 0);
+    EXPECT_LE(high_water, MM_ARENA_SIZE);
+
+    // a stopped pipeline is started again in the same memory
+    am_stop(am);
+    EXPECT_EQ(am_start(123, 50, 5), am);
+    am_stop(am);
+    EXPECT_EQ(mm_high_water(), high_water);
+}
+
+TEST_F(am_test, pipelines) {
+    std::vector<am_t *> pipelines;
+    for (int i = 0; i < MM_AM_INSTANCES; ++i) pipelines.push_back(am_start(123, 50, 5));
+    for (auto am : pipelines) ASSERT_TRUE(am != nullptr);
+    // all pipelines running
+    EXPECT_TRUE(am_start(123, 50, 5) == nullptr);
+    for (auto am : pipelines) am_stop(am);
+
+    // the stopped pipeline sends nothing
+    EXPECT_TRUE(am_sink(pipelines[0]).callback == nullptr);
+}
+
+TEST_F(am_test, keeps_unsent_messages) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    uint8_t buf1[] = { 99, 100, 101};
+    uint8_t buf2[] = {199, 200, 201};
+
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_INTERNAL_ERROR);
+    sink.callback(sink.context, buf1, 3, 0, 0);
+
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
+    sink.callback(sink.context, buf2, 3, 0, 0);
+
+    // the message that could not be sent goes first
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_GE(dicts.size(), 2);
+    auto data1 = dicts[dicts.size() - 2].get<std::vector<uint8_t>>(0xad000000);
+    auto data2 = dicts[dicts.size() - 1].get<std::vector<uint8_t>>(0xad000000);
+    ASSERT_EQ(data1.size(), sizeof(header) + 3);
+    ASSERT_EQ(data2.size(), sizeof(header) + 3);
+    EXPECT_EQ(std::vector<uint8_t>(data1.begin() + sizeof(header), data1.end()), std::vector<uint8_t>(buf1, buf1 + 3));
+    EXPECT_EQ(std::vector<uint8_t>(data2.begin() + sizeof(header), data2.end()), std::vector<uint8_t>(buf2, buf2 + 3));
+
+    am_stop(am);
+}
+
+TEST_F(am_test, control_messages_go_first) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
     uint8_t buf1[] = { 99, 100, 101};
     uint8_t buf2[] = {199, 200, 201};
 
     pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_INTERNAL_ERROR);
-    callback(buf1, 3, 0, 0);
+    sink.callback(sink.context, buf1, 3, 0, 0);
+    am_send_simple(am, msg_exercise_completed, 7);
+
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
+    sink.callback(sink.context, buf2, 3, 0, 0);
+
+    // the notification overtakes the batch queued before it
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_GE(dicts.size(), 3);
+    auto control = dicts[dicts.size() - 3].get<std::vector<uint8_t>>(msg_exercise_completed);
+    EXPECT_EQ(control, std::vector<uint8_t>({ 7 }));
+    EXPECT_EQ(dicts[dicts.size() - 2].get<std::vector<uint8_t>>(msg_ad).back(), 101);
+    EXPECT_EQ(dicts[dicts.size() - 1].get<std::vector<uint8_t>>(msg_ad).back(), 201);
+
+    am_stop(am);
+}
+
+TEST_F(am_test, busy_outbox_is_no_failure) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    uint8_t buf[] = { 1, 2, 3 };
+
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_BUSY);
+    for (int i = 0; i < 3; ++i) sink.callback(sink.context, buf, 3, 0, 0);
+    char status[128];
+    am_get_status(am, status, sizeof(status));
+    EXPECT_NE(std::string(status).find("\nEC: 0\n"), std::string::npos) << status;
+
+    // the next message takes the backlog along, one at a time
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+    am_send_simple(am, msg_exercise_completed, 7);
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), sent + 4);
+    EXPECT_TRUE(dicts[sent].contains(msg_exercise_completed));
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(dicts[sent + 1 + i].get<std::vector<uint8_t>>(msg_ad)[14], i);
+
+    am_stop(am);
+}
+
+TEST_F(am_test, failed_message_stays_queued) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    // the outbox takes the messages, and the phone's answer comes later
+    auto sent = app_message_register_outbox_sent([](DictionaryIterator *, void *) { });
+    auto failed = app_message_register_outbox_failed([](DictionaryIterator *, AppMessageResult, void *) { });
+    uint8_t buf[] = { 1, 2, 3 };
+    for (int i = 0; i < 2; ++i) sink.callback(sink.context, buf, 3, 0, 0);
+    ASSERT_EQ(pebble::mocks::app_messages()->dicts().size(), 1);
 
+    // the connection drops while the batch 0 is in the outbox; it goes again ahead of the batch 1
+    failed(nullptr, APP_MSG_NOT_CONNECTED, app_message_get_context());
+    sent(nullptr, app_message_get_context());
+    sent(nullptr, app_message_get_context());
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), 3);
+    EXPECT_EQ(dicts[0].get<std::vector<uint8_t>>(msg_ad)[14], 0);
+    EXPECT_EQ(dicts[1].get<std::vector<uint8_t>>(msg_ad)[14], 0);
+    EXPECT_EQ(dicts[2].get<std::vector<uint8_t>>(msg_ad)[14], 1);
+
+    app_message_register_outbox_sent(sent);
+    app_message_register_outbox_failed(failed);
+    am_stop(am);
+}
+
+TEST_F(am_test, free_outbox_takes_turned_away_pipeline) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    uint8_t buf[] = { 1, 2, 3 };
+
+    // the outbox is busy with a message of no pipeline, the log dump's
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_BUSY);
+    sink.callback(sink.context, buf, 3, 0, 0);
     pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
-    callback(buf2, 3, 0, 0);
+    auto sent = app_message_register_outbox_sent([](DictionaryIterator *, void *) { });
+    app_message_register_outbox_sent(sent);
+
+    // its sent handler gives the outbox to the pipeline turned away
+    auto count = pebble::mocks::app_messages()->dicts().size();
+    sent(nullptr, nullptr);
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), count + 1);
+    EXPECT_EQ(dicts[count].get<std::vector<uint8_t>>(msg_ad)[14], 0);
+
+    am_stop(am);
+}
+
+TEST_F(am_test, restart_sends_stopped_session_first) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    // the other pipelines are running, so the next start takes the stopped one
+    std::vector<am_t *> others;
+    for (int i = 1; i < MM_AM_INSTANCES; ++i) others.push_back(am_start(123, 100, 1));
+    uint8_t buf[] = { 1, 2, 3 };
+
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_BUSY);
+    sink.callback(sink.context, buf, 3, 0, 0);
+    am_stop(am);
+    ASSERT_EQ(am_start(123, 100, 1), am);
+
+    // the batch and the end of the stopped session go ahead of the new session's batch
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+    sink = am_sink(am);
+    sink.callback(sink.context, buf, 3, 0, 0);
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), sent + 3);
+    EXPECT_EQ(dicts[sent].get<std::vector<uint8_t>>(msg_ad)[14], 0);
+    EXPECT_EQ(dicts[sent + 1].get<std::vector<uint8_t>>(msg_dead)[14], 1);
+    EXPECT_EQ(dicts[sent + 2].get<std::vector<uint8_t>>(msg_ad)[14], 2);
+
+    am_stop(am);
+    for (auto other : others) am_stop(other);
+}
+
+TEST_F(am_test, ack_window) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_ack_window(am, 2);
+    uint8_t buf[] = { 1, 2, 3 };
+    for (int i = 0; i < 3; ++i) sink.callback(sink.context, buf, 3, 0, 0);
 
+    // the third batch waits for the acknowledgement of the first two
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+    EXPECT_EQ(sent, 2);
+    auto last = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    EXPECT_EQ(last[14], 1);
+
+    ack_range range = { 0, 0 };
+    am_ack_received(am, reinterpret_cast<uint8_t *>(&range), sizeof(range));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent + 1);
+    last = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    EXPECT_EQ(last[14], 2);
+
+    // nothing left to send until the acknowledgements arrive
+    range = { 1, 2 };
+    am_ack_received(am, reinterpret_cast<uint8_t *>(&range), sizeof(range));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent + 1);
+
+    am_stop(am);
+}
+
+TEST_F(am_test, keeps_unacknowledged_batches) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_ack_window(am, 1);
+    uint8_t buf[] = { 1, 2, 3 };
+    // the batch 0 is sent, its acknowledgement is late, and the batches 1 to 3 wait for it
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(sink.callback(sink.context, buf, 3, 0, 0));
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+
+    // the full queue keeps the batch 0 and drops the new batches; only the timeout sends the batch 0 again
+    EXPECT_FALSE(sink.callback(sink.context, buf, 3, 0, 0));
+    EXPECT_FALSE(sink.callback(sink.context, buf, 3, 0, 0));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent);
+
+    // acknowledged at last, the queue moves on; the dropped batches 4 and 5 leave a gap
+    ack_range range = { 0, 0 };
+    am_ack_received(am, reinterpret_cast<uint8_t *>(&range), sizeof(range));
+    EXPECT_EQ(pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad)[14], 1);
+    EXPECT_TRUE(sink.callback(sink.context, buf, 3, 0, 0));
+    for (uint16_t i = 1; i <= 2; ++i) {
+        range = { i, i };
+        am_ack_received(am, reinterpret_cast<uint8_t *>(&range), sizeof(range));
+    }
+    EXPECT_EQ(pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad)[14], 3);
+
+    // the stopped pipeline sends the batch 3, not acknowledged, once more, then the batch 6 and the end
+    sent = pebble::mocks::app_messages()->dicts().size();
+    am_stop(am);
     auto dicts = pebble::mocks::app_messages()->dicts();
-    auto data1 = dicts[0].get<std::vector<uint8_t>>(0xface0fb0);
-    auto data2 = dicts[1].get<std::vector<uint8_t>>(0xface0fb0);
-    bytes_equal<uint8_t>(data1, {123, 3, 100, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 99, 100, 101});
-    bytes_equal<uint8_t>(data2, {123, 3, 100, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 199, 200, 201});
+    ASSERT_EQ(dicts.size(), sent + 3);
+    EXPECT_EQ(dicts[sent].get<std::vector<uint8_t>>(msg_ad)[14], 3);
+    EXPECT_EQ(dicts[sent + 1].get<std::vector<uint8_t>>(msg_ad)[14], 6);
+    EXPECT_TRUE(dicts[sent + 2].contains(msg_dead));
+}
+
+TEST_F(am_test, resends_requested_batches) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_ack_window(am, 3);
+    uint8_t buf[] = { 1, 2, 3 };
+    for (int i = 0; i < 3; ++i) sink.callback(sink.context, buf, 3, 0, 0);
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+
+    // the batch 5 was never sent, the batch 1 goes again only
+    uint16_t requested[] = { 1, 5 };
+    am_resend_requested(am, reinterpret_cast<uint8_t *>(requested), sizeof(requested));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent + 1);
+    auto data = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    EXPECT_EQ(data[14], 1);
+    EXPECT_EQ(ck_message_crc(data.data(), (uint16_t)data.size()), data[27] | data[28] << 8);
+
+    am_stop(am);
+}
+
+TEST_F(am_test, resends_requested_batches_without_acknowledgements) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    uint8_t buf[] = { 1, 2, 3 };
+    for (int i = 0; i < 3; ++i) sink.callback(sink.context, buf, 3, 0, 0);
+    auto sent = pebble::mocks::app_messages()->dicts().size();
+
+    // sent once and kept all the same
+    uint16_t requested[] = { 1 };
+    am_resend_requested(am, reinterpret_cast<uint8_t *>(requested), sizeof(requested));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent + 1);
+    EXPECT_EQ(pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad)[14], 1);
+
+    // the new batches take the slots of the old ones
+    for (int i = 0; i < 4; ++i) sink.callback(sink.context, buf, 3, 0, 0);
+    sent = pebble::mocks::app_messages()->dicts().size();
+    uint16_t later[] = { 2, 5 };
+    am_resend_requested(am, reinterpret_cast<uint8_t *>(later), sizeof(later));
+    EXPECT_EQ(pebble::mocks::app_messages()->dicts().size(), sent + 1);
+    EXPECT_EQ(pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad)[14], 5);
 
-    am_stop();
+    am_stop(am);
 }
-*/
\ No newline at end of file
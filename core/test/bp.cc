@@ -0,0 +1,23 @@
+#include <gtest/gtest.h>
+#include "bp.h"
+
+TEST(bp_test, select) {
+    bp_thresholds thresholds = { 50, 30, 15 };
+    EXPECT_EQ(bp_select(&thresholds, bp_full, 80, false), bp_full);
+    EXPECT_EQ(bp_select(&thresholds, bp_full, 40, false), bp_decimated);
+    EXPECT_EQ(bp_select(&thresholds, bp_full, 20, false), bp_gated);
+    EXPECT_EQ(bp_select(&thresholds, bp_decimated, 10, false), bp_features);
+    EXPECT_EQ(bp_select(&thresholds, bp_features, 10, true), bp_full);
+
+    // going back up needs the hysteresis
+    EXPECT_EQ(bp_select(&thresholds, bp_gated, 30, false), bp_gated);
+    EXPECT_EQ(bp_select(&thresholds, bp_gated, 35, false), bp_decimated);
+    EXPECT_EQ(bp_select(&thresholds, bp_features, 60, false), bp_full);
+}
+
+TEST(bp_test, reduced_rate) {
+    EXPECT_EQ(bp_reduced_rate(100), 50);
+    EXPECT_EQ(bp_reduced_rate(50), 25);
+    EXPECT_EQ(bp_reduced_rate(25), 10);
+    EXPECT_EQ(bp_reduced_rate(10), 10);
+}
@@ -0,0 +1,13 @@
+#include <gtest/gtest.h>
+#include "ck.h"
+
+TEST(ck_test, check_value) {
+    const uint8_t digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    EXPECT_EQ(ck_crc16(CK_CRC16_INIT, digits, sizeof(digits)), 0x29b1);
+    EXPECT_EQ(ck_crc16(CK_CRC16_INIT, digits, 0), CK_CRC16_INIT);
+}
+
+TEST(ck_test, blocks) {
+    const uint8_t digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    EXPECT_EQ(ck_crc16(ck_crc16(CK_CRC16_INIT, digits, 4), digits + 4, 5), 0x29b1);
+}
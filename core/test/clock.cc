@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "clock.h"
+
+using namespace muvr;
+
+TEST(virtual_clock, fires_in_order_of_time_then_scheduling) {
+    virtual_clock clock(1000);
+    std::string fired;
+    clock.schedule(20, [&]() { fired += "c"; });
+    clock.schedule(10, [&]() { fired += "a"; });
+    clock.schedule(10, [&]() { fired += "b"; });
+    auto cancelled = clock.schedule(15, [&]() { fired += "x"; });
+
+    EXPECT_TRUE(clock.cancel(cancelled));
+    EXPECT_FALSE(clock.cancel(cancelled));
+    EXPECT_EQ(clock.run_until(1015), 2);
+    EXPECT_EQ(fired, "ab");
+    EXPECT_EQ(clock.now(), 1015);
+    EXPECT_EQ(clock.run_until(2000), 1);
+    EXPECT_EQ(fired, "abc");
+    EXPECT_EQ(clock.pending(), 0);
+}
+
+TEST(virtual_clock, sleep_blocks_the_running_event_only) {
+    virtual_clock clock(0);
+    uint64_t woke = 0, other = 0, scheduled = 0;
+    clock.schedule(100, [&]() {
+        clock.sleep(200);
+        woke = clock.now();
+        // relative to the time the event sees
+        clock.schedule(50, [&]() { scheduled = clock.now(); });
+    });
+    clock.schedule(150, [&]() { other = clock.now(); });
+
+    clock.run_until(1000);
+    EXPECT_EQ(woke, 300);
+    EXPECT_EQ(other, 150);
+    EXPECT_EQ(scheduled, 350);
+    EXPECT_EQ(clock.now(), 1000);
+}
+
+TEST(virtual_clock, hours_of_periodic_events) {
+    virtual_clock clock(0);
+    uint64_t ticks = 0;
+    std::function<void()> tick = [&]() {
+        ++ticks;
+        clock.schedule(200, tick);
+    };
+    clock.schedule(0, tick);
+
+    // ten hours of the accelerometer service updates at 50 Hz
+    clock.run_until(10 * 3600 * 1000);
+    EXPECT_EQ(ticks, 10 * 3600 * 5 + 1);
+}
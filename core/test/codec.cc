@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "codec.h"
+
+using namespace muvr;
+
+template <typename Layout>
+class codec_test : public testing::Test {
+protected:
+    std::vector<axes> samples() const {
+        std::vector<axes> result;
+        for (int i = 0; i < 50; ++i) {
+            result.push_back(axes { (int16_t)(1500 * sin(i / 8.0)), (int16_t)(-40 * i), (int16_t)(981 + i % 5) });
+        }
+        return result;
+    }
+
+    // the largest difference of a decoded value: none, or half a level of the scaled layouts
+    double tolerance(const uint16_t range) const {
+        return Layout::scaled ? (double)range / ((1 << (Layout::encoding - 1)) - 1) / 2 + 1 : 0;
+    }
+};
+
+typedef testing::Types<codec::packed13, codec::quantised<8>, codec::quantised<10>, codec::quantised<12>, codec::delta> layouts;
+TYPED_TEST_CASE(codec_test, layouts);
+
+TYPED_TEST(codec_test, round_trip) {
+    const uint16_t range = 4000;
+    auto samples = this->samples();
+    auto payload = codec::encode<TypeParam>(samples, range);
+    auto decoded = codec::decode<TypeParam>(payload.data(), payload.size(), samples.size(), range);
+
+    ASSERT_EQ(decoded.size(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_NEAR(decoded[i].x, samples[i].x, this->tolerance(range));
+        EXPECT_NEAR(decoded[i].y, samples[i].y, this->tolerance(range));
+        EXPECT_NEAR(decoded[i].z, samples[i].z, this->tolerance(range));
+    }
+}
+
+TYPED_TEST(codec_test, short_payload) {
+    auto payload = codec::encode<TypeParam>(this->samples(), 4000);
+    EXPECT_THROW(codec::decode<TypeParam>(payload.data(), payload.size() - 1, this->samples().size(), 4000), std::invalid_argument);
+}
+
+TEST(codec, traits) {
+    static_assert(codec::payload_size<codec::packed13>(10) == 10 * sizeof(threed_data), "13 bits in threed_data");
+    static_assert(codec::payload_size<codec::quantised<8>>(10) == 30, "3 B per sample");
+    static_assert(codec::payload_size<codec::quantised<10>>(3) == 12, "30 bits per sample, padded");
+    static_assert(codec::quantised<12>::bit_offset(2) == 24, "the z axis after x and y");
+
+    // the packed layout is the watch's struct threed_data
+    threed_data data[2] = { { 100, -200, 4095, 0 }, { -4095, 0, 1, 0 } };
+    auto decoded = codec::decode<codec::packed13>(reinterpret_cast<uint8_t *>(data), sizeof(data), 2);
+    EXPECT_EQ(decoded[0].y, -200);
+    EXPECT_EQ(decoded[0].z, 4095);
+    EXPECT_EQ(decoded[1].x, -4095);
+    EXPECT_EQ(decoded[1].z, 1);
+}
+
+TEST(codec, delta_limits) {
+    // ec_decode takes the size and the count in uint16_t, which must not wrap around
+    std::vector<uint8_t> payload(UINT16_MAX + 1, 0);
+    EXPECT_THROW(codec::decode<codec::delta>(payload.data(), payload.size(), 10), std::invalid_argument);
+    EXPECT_THROW(codec::decode<codec::delta>(payload.data(), 10, UINT16_MAX + 1), std::invalid_argument);
+    EXPECT_THROW(codec::encode<codec::delta>(std::vector<axes>(UINT16_MAX + 1)), std::invalid_argument);
+
+    // the samples that code to more than 65535 B
+    std::vector<axes> samples(30000);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = i % 2 == 0 ? axes { 4095, -4095, 4095 } : axes { -4095, 4095, -4095 };
+    EXPECT_THROW(codec::encode<codec::delta>(samples), std::invalid_argument);
+}
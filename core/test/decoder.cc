@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include "am.h"
+#include "ad.h"
+#include "sd.h"
+#include "decoder.h"
+#include "mocks.h"
+
+class decoder_test : public testing::Test {
+protected:
+    virtual void SetUp() {
+        pebble::mocks::reset();
+    }
+};
+
+TEST_F(decoder_test, sample_times) {
+    threed_data accelerometer[4];
+    for (int i = 0; i < 4; i++) {
+        accelerometer[i].x_val = i;
+        accelerometer[i].y_val = -i;
+        accelerometer[i].z_val = 4095;
+    }
+
+    auto am = am_start(0x516c6174, 50, sizeof(threed_data));
+    auto sink = am_sink(am);
+    // 20.125 ms between samples
+    sink.callback(sink.context, reinterpret_cast<uint8_t *>(accelerometer), sizeof(accelerometer), 1449000000.250, (20 << 8) + 32);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    auto batch = muvr::decode(message);
+    EXPECT_EQ(batch.type, 0x516c6174);
+    EXPECT_EQ(batch.samples_per_second, 50);
+    ASSERT_EQ(batch.samples.size(), 4);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_DOUBLE_EQ(batch.samples[i].time, 1449000000250 + i * 20.125);
+        EXPECT_EQ(batch.samples[i].x, i);
+        EXPECT_EQ(batch.samples[i].y, -i);
+        EXPECT_EQ(batch.samples[i].z, 4095);
+    }
+}
+
+TEST_F(decoder_test, sensor_stream) {
+    sensor_data heart_rate[3] = { { 0, 72 }, { 1010, 75 }, { 1990, 81 } };
+
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto sink = am_add_stream(am, SD_TYPE_HEART_RATE, 0, sizeof(sensor_data), 1);
+    ASSERT_TRUE(sink.callback != nullptr);
+    EXPECT_NE(sink.context, am_sink(am).context);
+    EXPECT_EQ(am_add_stream(am, SD_TYPE_HEART_RATE, 0, sizeof(sensor_data), 1).context, sink.context);
+
+    sink.callback(sink.context, reinterpret_cast<uint8_t *>(heart_rate), sizeof(heart_rate), 1449000000.250, 0);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    auto batch = muvr::decode(message);
+    EXPECT_EQ(batch.type, SD_TYPE_HEART_RATE);
+    ASSERT_EQ(batch.samples.size(), 3);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_DOUBLE_EQ(batch.samples[i].time, 1449000000250 + heart_rate[i].offset);
+        EXPECT_EQ(batch.samples[i].x, heart_rate[i].value);
+    }
+}
+
+TEST_F(decoder_test, quantised_samples) {
+    std::vector<AccelRawData> mock_data;
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(AccelRawData { (int16_t)(i * 100), (int16_t)(-i * 300), 981 });
+
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto ad = ad_open();
+    ad_start(ad, am_sink(am), 50, 1000);
+    ad_set_encoding(ad, AD_ENCODING_10_BITS, 2000);
+    am_set_encoding(am, AD_ENCODING_10_BITS, 2000);
+    *pebble::mocks::accel_service() << mock_data;
+    ad_close(ad);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    // 3.75 B per sample, each value within half a level of 2000 / 511 mg
+    EXPECT_EQ(message.size(), sizeof(header) + (AD_NUM_SAMPLES * 30 + 7) / 8);
+    auto batch = muvr::decode(message);
+    ASSERT_EQ(batch.samples.size(), AD_NUM_SAMPLES);
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) {
+        EXPECT_NEAR(batch.samples[i].x, i * 100, 2);
+        EXPECT_NEAR(batch.samples[i].y, std::max(-i * 300, -2000), 2);
+        EXPECT_NEAR(batch.samples[i].z, 981, 2);
+    }
+}
+
+TEST_F(decoder_test, entropy_coded_samples) {
+    std::vector<AccelRawData> mock_data;
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(AccelRawData { (int16_t)(i * 10), -1000, 981 });
+
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto ad = ad_open();
+    ad_start(ad, am_sink(am), 50, 1000);
+    ad_set_encoding(ad, AD_ENCODING_ENTROPY, 0);
+    am_set_encoding(am, AD_ENCODING_ENTROPY, 0);
+    *pebble::mocks::accel_service() << mock_data;
+    ad_close(ad);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    EXPECT_LT(message.size(), sizeof(header) + AD_NUM_SAMPLES * sizeof(threed_data));
+    auto batch = muvr::decode(message);
+    ASSERT_EQ(batch.samples.size(), AD_NUM_SAMPLES);
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) {
+        EXPECT_EQ(batch.samples[i].x, i * 10);
+        EXPECT_EQ(batch.samples[i].y, -1000);
+        EXPECT_EQ(batch.samples[i].z, 981);
+    }
+}
+
+TEST_F(decoder_test, features) {
+    std::vector<AccelRawData> mock_data;
+    for (int i = 0; i < AD_NUM_SAMPLES; i++) mock_data.push_back(AccelRawData { (int16_t)(i % 2 == 0 ? 100 : -100), 50, -1000 });
+
+    // the features mode the way main.c applies it
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto ad = ad_open();
+    ad_start(ad, am_sink(am), 50, 1000);
+    ad_set_mode(ad, AD_MODE_FEATURES);
+    am_reconfigure(am, AD_TYPE_FEATURES, 50, sizeof(threed_features), AD_FEATURES_VALUES);
+    *pebble::mocks::accel_service() << mock_data;
+    ad_close(ad);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    header h;
+    memcpy(&h, message.data(), sizeof(header));
+    EXPECT_EQ(h.count, AD_FEATURES_VALUES);
+    auto batch = muvr::decode(message);
+    EXPECT_EQ(batch.type, AD_TYPE_FEATURES);
+    EXPECT_TRUE(batch.samples.empty());
+    ASSERT_EQ(batch.features.size(), 1);
+    EXPECT_EQ(batch.features[0].x_mean, 0);
+    EXPECT_EQ(batch.features[0].y_mean, 50);
+    EXPECT_EQ(batch.features[0].z_mean, -1000);
+    EXPECT_EQ(batch.features[0].x_deviation, 100);
+    EXPECT_EQ(batch.features[0].y_deviation, 0);
+    EXPECT_EQ(batch.features[0].z_deviation, 0);
+}
+
+TEST_F(decoder_test, malformed) {
+    EXPECT_THROW(muvr::decode({ 0x61, 0x65 }), std::invalid_argument);
+
+    std::vector<uint8_t> message(sizeof(header) + 3, 0);
+    message[0] = 0x61;
+    message[1] = 0x65;
+    message[offsetof(header, count)] = 3;
+    EXPECT_THROW(muvr::decode(message), std::invalid_argument);
+}
+
+TEST_F(decoder_test, corrupted) {
+    threed_data accelerometer[4] = { };
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto sink = am_sink(am);
+    sink.callback(sink.context, reinterpret_cast<uint8_t *>(accelerometer), sizeof(accelerometer), 1449000000, 20 << 8);
+    auto message = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    EXPECT_EQ(muvr::decode(message).samples.size(), 4);
+    for (size_t i : { offsetof(header, timestamp), sizeof(header) + 7 }) {
+        auto corrupted = message;
+        corrupted[i] ^= 0x10;
+        EXPECT_THROW(muvr::decode(corrupted), std::invalid_argument);
+    }
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "ec.h"
+#include "sg.h"
+
+static std::vector<threed_data> walk(size_t count) {
+    std::vector<threed_data> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        samples[i].x_val = (int16_t)(1000 * sin(i / 10.0));
+        samples[i].y_val = (int16_t)(-300 + (i % 7) * 5);
+        samples[i].z_val = (int16_t)(981 + (i % 3));
+        samples[i]._ = 0;
+    }
+    return samples;
+}
+
+TEST(ec_test, round_trip) {
+    auto samples = walk(50);
+    uint8_t encoded[50 * sizeof(threed_data)];
+    uint16_t size = ec_encode(samples.data(), 50, encoded, sizeof(encoded));
+    ASSERT_GT(size, 0);
+    EXPECT_LT(size, sizeof(encoded));
+
+    std::vector<threed_data> decoded(50);
+    ASSERT_EQ(ec_decode(encoded, size, decoded.data(), 50), 0);
+    for (size_t i = 0; i < 50; ++i) {
+        EXPECT_EQ(decoded[i].x_val, samples[i].x_val);
+        EXPECT_EQ(decoded[i].y_val, samples[i].y_val);
+        EXPECT_EQ(decoded[i].z_val, samples[i].z_val);
+    }
+}
+
+TEST(ec_test, largest_differences) {
+    std::vector<threed_data> samples(10);
+    for (size_t i = 0; i < 10; ++i) {
+        int16_t v = i % 2 == 0 ? 4095 : -4095;
+        samples[i].x_val = v;
+        samples[i].y_val = -v;
+        samples[i].z_val = v;
+    }
+
+    // 13 bits of the difference and 9 bits of the code do not fit in the packed size
+    uint8_t encoded[10 * sizeof(threed_data)];
+    EXPECT_EQ(ec_encode(samples.data(), 10, encoded, sizeof(encoded)), 0);
+
+    uint8_t larger[10 * 9];
+    uint16_t size = ec_encode(samples.data(), 10, larger, sizeof(larger));
+    ASSERT_GT(size, 0);
+    std::vector<threed_data> decoded(10);
+    ASSERT_EQ(ec_decode(larger, size, decoded.data(), 10), 0);
+    for (size_t i = 0; i < 10; ++i) EXPECT_EQ(decoded[i].y_val, samples[i].y_val);
+}
+
+TEST(ec_test, corrupt) {
+    auto samples = walk(20);
+    uint8_t encoded[20 * sizeof(threed_data)];
+    uint16_t size = ec_encode(samples.data(), 20, encoded, sizeof(encoded));
+    ASSERT_GT(size, 0);
+
+    std::vector<threed_data> decoded(21);
+    EXPECT_EQ(ec_decode(encoded, size - 1, decoded.data(), 20), E_EC_CORRUPT);
+    EXPECT_EQ(ec_decode(encoded, size, decoded.data(), 21), E_EC_CORRUPT);
+    EXPECT_EQ(ec_decode(encoded, size, decoded.data(), 10), E_EC_CORRUPT);
+}
+
+/// Returns the ratio of the packed to the entropy-coded size of 1 s batches of 10 s of the ``signal`` at 50 Hz
+static double compression_ratio(const uint8_t signal) {
+    sg_generator generator;
+    memset(&generator, 0, sizeof(generator));
+    EXPECT_EQ(sg_start(&generator, signal, 42), 0);
+
+    size_t packed = 0, coded = 0;
+    for (int batch = 0; batch < 10; ++batch) {
+        AccelRawData raw[50];
+        sg_fill(&generator, raw, 50, 1000000 + batch * 1000, 20 << 8);
+        threed_data samples[50];
+        for (int i = 0; i < 50; ++i) samples[i] = threed_data { raw[i].x, raw[i].y, raw[i].z, 0 };
+
+        uint8_t encoded[50 * 9];
+        uint16_t size = ec_encode(samples, 50, encoded, sizeof(encoded));
+        EXPECT_GT(size, 0);
+        packed += sizeof(samples);
+        coded += size;
+    }
+    return (double)packed / coded;
+}
+
+TEST(ec_test, compression_ratio) {
+    // reported, so that a table generated from the recorded sessions can be compared
+    const char *names[] = { "sine", "chirp", "step", "noise" };
+    double ratios[4];
+    for (uint8_t signal = SG_SIGNAL_SINE; signal <= SG_SIGNAL_NOISE; ++signal) {
+        ratios[signal - SG_SIGNAL_SINE] = compression_ratio(signal);
+        std::cout << names[signal - SG_SIGNAL_SINE] << ": " << ratios[signal - SG_SIGNAL_SINE] << "x" << std::endl;
+    }
+
+    // the floors of the placeholder table of ec_table.h, about 1.7x on the smooth movements and more
+    // at rest; short of the 3-4x the coding was meant for, and not measured on the recorded sessions
+    EXPECT_GT(ratios[0], 1.5);
+    EXPECT_GT(ratios[1], 1.5);
+    EXPECT_GT(ratios[2], 3.0);
+    // the noise does not compress, and am sends it packed
+    EXPECT_LT(ratios[3], 1.0);
+}
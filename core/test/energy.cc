@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "am.h"
+#include "ad.h"
+#include "bp.h"
+#include "energy.h"
+#include "mocks.h"
+
+using namespace pebble;
+
+class energy_test : public testing::Test {
+protected:
+    virtual void SetUp() {
+        mocks::reset();
+    }
+
+    /// Captures ``seconds`` of still samples in the ``profile`` the way main.c applies it,
+    /// returning the workload of the sent messages
+    muvr::workload capture(const bp_profile_t profile, const int seconds) {
+        uint8_t rate = profile == bp_full ? 50 : bp_reduced_rate(50);
+        uint8_t mode = profile == bp_gated ? AD_MODE_GATED : (profile == bp_features ? AD_MODE_FEATURES : AD_MODE_RAW);
+
+        auto am = am_start(AD_TYPE_ACCELEROMETER, rate, sizeof(threed_data));
+        auto ad = ad_open();
+        ad_start(ad, am_sink(am), rate, 1000);
+        ad_set_mode(ad, mode);
+        if (mode == AD_MODE_FEATURES) am_reconfigure(am, AD_TYPE_FEATURES, rate, sizeof(threed_features), AD_FEATURES_VALUES);
+
+        std::vector<AccelRawData> still(AD_NUM_SAMPLES, AccelRawData { .x = 0, .y = 0, .z = -1000 });
+        for (int i = 0; i < rate * seconds / AD_NUM_SAMPLES; i++) *mocks::accel_service() << still;
+        ad_close(ad);
+
+        std::vector<std::vector<uint8_t>> messages;
+        for (auto &dict : mocks::app_messages()->dicts()) messages.push_back(dict.get<std::vector<uint8_t>>(msg_ad));
+        am_stop(am);
+        mocks::reset();
+
+        return muvr::measure(messages, rate, seconds);
+    }
+};
+
+TEST_F(energy_test, model) {
+    muvr::energy_model model;
+    muvr::workload idle { 0, 0, 0 };
+    EXPECT_DOUBLE_EQ(muvr::battery_hours(model, idle), model.battery_capacity / model.idle_current);
+
+    muvr::workload busy { 50, 1, 270 };
+    EXPECT_LT(muvr::battery_hours(model, busy), muvr::battery_hours(model, idle));
+    EXPECT_THROW(muvr::measure({}, 50, 0), std::invalid_argument);
+}
+
+TEST_F(energy_test, profiles) {
+    muvr::energy_model model;
+    auto full = capture(bp_full, 10);
+    auto decimated = capture(bp_decimated, 10);
+    auto gated = capture(bp_gated, 10);
+    auto features = capture(bp_features, 10);
+
+    EXPECT_GT(full.messages_per_second, 0);
+    EXPECT_LT(decimated.bytes_per_second, full.bytes_per_second);
+    // no movement, nothing sent
+    EXPECT_EQ(gated.messages_per_second, 0);
+    EXPECT_LT(features.bytes_per_second, decimated.bytes_per_second);
+
+    EXPECT_LT(muvr::battery_hours(model, full), muvr::battery_hours(model, decimated));
+    EXPECT_LT(muvr::battery_hours(model, decimated), muvr::battery_hours(model, features));
+    EXPECT_LE(muvr::battery_hours(model, features), muvr::battery_hours(model, gated));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "am.h"
+#include "fec.h"
+#include "mocks.h"
+
+class fec_test : public testing::Test {
+protected:
+    virtual void SetUp() {
+        pebble::mocks::reset();
+    }
+};
+
+TEST_F(fec_test, recovers_any_lost_batch) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_fec_group(am, 3);
+    uint8_t buf1[] = { 1, 2, 3 };
+    uint8_t buf2[] = { 4, 5, 6, 7, 8 };
+    uint8_t buf3[] = { 9 };
+    sink.callback(sink.context, buf1, sizeof(buf1), 0, 0);
+    sink.callback(sink.context, buf2, sizeof(buf2), 0, 0);
+    sink.callback(sink.context, buf3, sizeof(buf3), 0, 0);
+
+    // the parity follows the last batch of the group
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), 4);
+    std::vector<std::vector<uint8_t>> batches;
+    for (int i = 0; i < 3; ++i) batches.push_back(dicts[i].get<std::vector<uint8_t>>(msg_ad));
+    auto parity = dicts[3].get<std::vector<uint8_t>>(msg_parity);
+    EXPECT_EQ(parity.size(), sizeof(parity_header) + batches[1].size());
+
+    EXPECT_TRUE(muvr::recover(parity, batches).empty());
+    for (size_t lost = 0; lost < batches.size(); ++lost) {
+        auto received = batches;
+        received.erase(received.begin() + lost);
+        EXPECT_EQ(muvr::recover(parity, received), batches[lost]);
+    }
+    EXPECT_THROW(muvr::recover(parity, { batches[0] }), std::invalid_argument);
+
+    am_stop(am);
+}
+
+TEST_F(fec_test, session_end_closes_the_group) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_fec_group(am, 4);
+    uint8_t buf[] = { 1, 2, 3 };
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+    am_stop(am);
+
+    // the parity of the two batches goes ahead of msg_dead
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), 4);
+    auto parity = dicts[2].get<std::vector<uint8_t>>(msg_parity);
+    parity_header p;
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    EXPECT_EQ(p.first, 0);
+    EXPECT_EQ(p.count, 2);
+    EXPECT_EQ(muvr::recover(parity, { dicts[1].get<std::vector<uint8_t>>(msg_ad) }), dicts[0].get<std::vector<uint8_t>>(msg_ad));
+    dicts[3].get<std::vector<uint8_t>>(msg_dead);
+}
+
+TEST_F(fec_test, gap_closes_the_group) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_fec_group(am, 2);
+    uint8_t buf[] = { 1, 2, 3 };
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+
+    // the full queue drops the batch 5 while the phone does not take the batches
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_INTERNAL_ERROR);
+    for (int i = 0; i < 5; ++i) sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+    pebble::mocks::app_messages()->set_outbox_send_result(APP_MSG_OK);
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+
+    // 0, 1, parity, 2, 3, parity, 4, parity, 6
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_GE(dicts.size(), 9);
+    parity_header p;
+    auto parity = dicts[dicts.size() - 7].get<std::vector<uint8_t>>(msg_parity);
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    EXPECT_EQ(p.first, 0);
+    EXPECT_EQ(p.count, 2);
+    parity = dicts[dicts.size() - 4].get<std::vector<uint8_t>>(msg_parity);
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    EXPECT_EQ(p.first, 2);
+    EXPECT_EQ(p.count, 2);
+    parity = dicts[dicts.size() - 2].get<std::vector<uint8_t>>(msg_parity);
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    EXPECT_EQ(p.first, 4);
+    EXPECT_EQ(p.count, 1);
+    EXPECT_EQ(dicts[dicts.size() - 1].get<std::vector<uint8_t>>(msg_ad)[14], 6);
+
+    am_stop(am);
+}
+
+TEST_F(fec_test, clamped_group_keeps_the_group) {
+    auto am = am_start(123, 100, 1);
+    auto sink = am_sink(am);
+    am_set_fec_group(am, AM_MAX_FEC_GROUP);
+    uint8_t buf[] = { 1, 2, 3 };
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+    sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+
+    // the larger group is the same group once clamped, so the parity still waits for its last batch
+    am_set_fec_group(am, AM_MAX_FEC_GROUP + 1);
+    ASSERT_EQ(pebble::mocks::app_messages()->dicts().size(), 2);
+    for (int i = 2; i < AM_MAX_FEC_GROUP; ++i) sink.callback(sink.context, buf, sizeof(buf), 0, 0);
+
+    auto dicts = pebble::mocks::app_messages()->dicts();
+    ASSERT_EQ(dicts.size(), AM_MAX_FEC_GROUP + 1);
+    auto parity = dicts[AM_MAX_FEC_GROUP].get<std::vector<uint8_t>>(msg_parity);
+    parity_header p;
+    memcpy(&p, parity.data(), sizeof(parity_header));
+    EXPECT_EQ(p.first, 0);
+    EXPECT_EQ(p.count, AM_MAX_FEC_GROUP);
+
+    am_stop(am);
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+// the debug events are compiled out of this file
+#define LG_LEVEL LG_LEVEL_INFO
+#include "lg.h"
+#include "log.h"
+#include "am.h"
+#include "bp.h"
+#include "mocks.h"
+
+class lg_test : public testing::Test {
+protected:
+    virtual void SetUp() {
+        pebble::mocks::reset();
+        lg_clear();
+    }
+
+    std::vector<muvr::log_entry> read() {
+        uint8_t buffer[sizeof(struct lg_record) * LG_RING_LENGTH];
+        return muvr::format_log(buffer, lg_read(buffer, sizeof(buffer)));
+    }
+};
+
+TEST_F(lg_test, formats_on_the_host) {
+    LG_ERROR(LG_AM_TOO_LARGE, 600, 520);
+    LG_INFO(LG_BP_PROFILE, 14, bp_gated, bp_features);
+    LG_ERROR(LG_AM_NO_SPACE);
+
+    auto entries = read();
+    ASSERT_EQ(entries.size(), 3);
+    EXPECT_EQ(entries[0].event, LG_AM_TOO_LARGE);
+    EXPECT_EQ(entries[0].text, "am: needed 600, had 520 B");
+    EXPECT_EQ(entries[1].text, "bp: 14% charge, profile 2 -> 3");
+    EXPECT_EQ(entries[2].text, "am: no space in the arena");
+}
+
+TEST_F(lg_test, levels_above_are_compiled_out) {
+    int evaluated = 0;
+    LG_DEBUG(LG_AM_SENT, ++evaluated, 10);
+    LG_INFO(LG_AM_CONNECTION, ++evaluated, 0);
+
+    EXPECT_EQ(evaluated, 1);
+    EXPECT_EQ(lg_written(), 1);
+}
+
+TEST_F(lg_test, keeps_the_newest_records) {
+    for (int i = 0; i < LG_RING_LENGTH + 5; ++i) LG_ERROR(LG_EXIT, i);
+
+    auto entries = read();
+    EXPECT_EQ(lg_written(), LG_RING_LENGTH + 5);
+    ASSERT_EQ(entries.size(), LG_RING_LENGTH);
+    EXPECT_EQ(entries.front().text, "exit(5)");
+    EXPECT_EQ(entries.back().text, "exit(" + std::to_string(LG_RING_LENGTH + 4) + ")");
+
+    // sent in one message, the oldest first
+    ASSERT_EQ(lg_send(), 0);
+    auto sent = pebble::mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_log);
+    auto sent_entries = muvr::format_log(sent.data(), sent.size());
+    ASSERT_EQ(sent_entries.size(), LG_RING_LENGTH);
+    EXPECT_EQ(sent_entries.front().text, "exit(5)");
+    EXPECT_EQ(read().front().text, "exit(5)");
+}
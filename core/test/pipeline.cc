@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <thread>
+#include "pipeline.h"
+#include "codec.h"
+#include "am.h"
+#include "ad.h"
+#include "sd.h"
+#include "ck.h"
+
+using namespace muvr;
+
+///
+/// Returns the ``msg_ad`` message of the ``samples`` packed in 13 bits per axis, sent at ``timestamp`` s
+///
+static std::vector<uint8_t> packed_message(const uint32_t type, const std::vector<axes> &samples, const double timestamp) {
+    header h;
+    memset(&h, 0, sizeof(header));
+    h.preamble1 = 0x61;
+    h.preamble2 = 0x65;
+    h.types_count = 1;
+    h.samples_per_second = 50;
+    h.timestamp = timestamp;
+    h.sample_interval = 20 << 8;
+    h.encoding = AD_ENCODING_PACKED;
+    h.count = (uint32_t)samples.size() * 3;
+    h.type = type;
+
+    auto payload = codec::encode<codec::packed13>(samples);
+    std::vector<uint8_t> message(reinterpret_cast<uint8_t *>(&h), reinterpret_cast<uint8_t *>(&h) + sizeof(header));
+    message.insert(message.end(), payload.begin(), payload.end());
+    h.crc = ck_message_crc(message.data(), (uint16_t)message.size());
+    memcpy(message.data() + offsetof(header, crc), &h.crc, sizeof(h.crc));
+    return message;
+}
+
+TEST(spsc_ring, batches_wrap_around) {
+    spsc_ring<int, 8> ring;
+    int in[6] = { 0, 1, 2, 3, 4, 5 };
+    int out[8];
+
+    EXPECT_EQ(ring.push(in, 6), 6);
+    EXPECT_EQ(ring.pop(out, 4), 4);
+    EXPECT_EQ(out[3], 3);
+    // 2 left, 6 free; the next push wraps around the end of the storage
+    EXPECT_EQ(ring.push(in, 6), 6);
+    EXPECT_EQ(ring.push(in, 6), 0);
+    EXPECT_EQ(ring.size(), 8);
+    EXPECT_EQ(ring.pop(out, 8), 8);
+    EXPECT_EQ(out[0], 4);
+    EXPECT_EQ(out[1], 5);
+    for (int i = 0; i < 6; ++i) EXPECT_EQ(out[i + 2], i);
+    EXPECT_EQ(ring.pop(out, 8), 0);
+}
+
+TEST(spsc_ring, two_threads_keep_order) {
+    const int count = 500000;
+    spsc_ring<int, 64> ring;
+    std::thread producer([&ring]() {
+        int batch[7];
+        for (int next = 0; next < count;) {
+            int n = std::min(7, count - next);
+            for (int i = 0; i < n; ++i) batch[i] = next + i;
+            size_t pushed = ring.push(batch, n);
+            if (pushed == 0) std::this_thread::yield();
+            next += (int)pushed;
+        }
+    });
+
+    int expected = 0;
+    bool ordered = true;
+    int batch[16];
+    while (expected < count) {
+        size_t n = ring.pop(batch, 16);
+        if (n == 0) std::this_thread::yield();
+        for (size_t i = 0; i < n; ++i) ordered &= batch[i] == expected++;
+    }
+    producer.join();
+    EXPECT_TRUE(ordered);
+}
+
+TEST(pipeline, classifies_the_windows_of_every_watch) {
+    std::vector<classification> classifications;
+    pipeline pipeline(pipeline_config(), [&classifications](const classification &c) { classifications.push_back(c); });
+
+    // 20 messages of 10 samples from each watch: the windows of 100 samples start at 0, 50 and 100
+    for (int m = 0; m < 20; ++m) {
+        for (uint32_t watch = 0; watch < 3; ++watch) {
+            std::vector<axes> samples;
+            for (int i = 0; i < 10; ++i) {
+                double a = sin((m * 10 + i) / 4.0);
+                int16_t amplitude = watch == 0 ? 0 : (watch == 1 ? 200 : 1000);
+                samples.push_back(axes { (int16_t)(amplitude * a), (int16_t)(amplitude * a), -1000 });
+            }
+            pipeline.submit(message { watch, packed_message(AD_TYPE_ACCELEROMETER, samples, 1449000000 + m * 0.2) });
+        }
+    }
+    pipeline.close();
+
+    auto statistics = pipeline.statistics();
+    EXPECT_EQ(statistics.messages, 60);
+    EXPECT_EQ(statistics.malformed, 0);
+    EXPECT_EQ(statistics.samples, 600);
+    EXPECT_EQ(statistics.windows, 9);
+
+    std::map<uint32_t, std::vector<classification>> by_watch;
+    for (auto &c : classifications) by_watch[c.watch].push_back(c);
+    const activity expected[3] = { activity::not_moving, activity::moving, activity::exercising };
+    for (uint32_t watch = 0; watch < 3; ++watch) {
+        ASSERT_EQ(by_watch[watch].size(), 3);
+        for (size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(by_watch[watch][i].activity, expected[watch]);
+            EXPECT_DOUBLE_EQ(by_watch[watch][i].time, 1449000000000 + i * 1000);
+        }
+    }
+}
+
+TEST(pipeline, drops_malformed_and_other_streams) {
+    size_t classified = 0;
+    pipeline_config config;
+    config.window_size = 10;
+    config.window_step = 10;
+    pipeline pipeline(config, [&classified](const classification &) { ++classified; });
+
+    std::vector<axes> samples(10, axes { 0, 0, -1000 });
+    auto good = packed_message(AD_TYPE_ACCELEROMETER, samples, 1449000000);
+    auto truncated = good;
+    truncated.pop_back();
+    auto bad_preamble = good;
+    bad_preamble[0] = 0;
+    auto unknown_encoding = good;
+    unknown_encoding[offsetof(header, encoding)] = 3;
+
+    message messages[] = {
+        message { 0, good },
+        message { 0, truncated },
+        message { 0, bad_preamble },
+        message { 0, unknown_encoding },
+        message { 0, std::vector<uint8_t>(good.begin(), good.begin() + 10) },
+        message { 0, packed_message(SD_TYPE_HEART_RATE, samples, 1449000000) },
+        message { 0, good }
+    };
+    pipeline.submit(messages, 7);
+    pipeline.close();
+
+    auto statistics = pipeline.statistics();
+    EXPECT_EQ(statistics.messages, 7);
+    EXPECT_EQ(statistics.malformed, 4);
+    EXPECT_EQ(statistics.skipped, 1);
+    EXPECT_EQ(statistics.samples, 20);
+    EXPECT_EQ(classified, 2);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "sd.h"
+#include "am.h"
+#include "ad.h"
+#include "decoder.h"
+#include "mocks.h"
+#include "sensor_mocks.h"
+
+using namespace pebble;
+
+static bool sd_callback(void *context, const uint8_t *buffer, const uint16_t size, const double timestamp, const uint16_t sample_interval) {
+    return true;
+}
+
+TEST(sd_test, start_stop) {
+    const message_sink sink { sd_callback, nullptr };
+    EXPECT_EQ(sd_stop(SD_SENSOR_COMPASS), E_SD_NOT_RUNNING);
+    EXPECT_EQ(sd_start(SD_SENSOR_COUNT, sink, 1000), E_SD_INVALID_CONFIG);
+    EXPECT_EQ(sd_start(SD_SENSOR_COMPASS, sink, 0), E_SD_INVALID_CONFIG);
+
+    EXPECT_EQ(sd_start(SD_SENSOR_COMPASS, sink, 1000), 0);
+    // starting again reconfigures the running sensor
+    EXPECT_EQ(sd_start(SD_SENSOR_COMPASS, sink, 500), 0);
+    EXPECT_EQ(sd_stop(SD_SENSOR_COMPASS), 1);
+    EXPECT_EQ(sd_stop(SD_SENSOR_COMPASS), E_SD_NOT_RUNNING);
+}
+
+/// The buffers submitted to one sink and the times of their first readings
+struct readings {
+    std::vector<std::vector<sensor_data>> buffers;
+    std::vector<double> timestamps;
+};
+
+static bool readings_callback(void *context, const uint8_t *buffer, const uint16_t size, const double timestamp, const uint16_t sample_interval) {
+    auto r = static_cast<readings *>(context);
+    auto data = reinterpret_cast<const sensor_data *>(buffer);
+    r->buffers.push_back(std::vector<sensor_data>(data, data + size / sizeof(sensor_data)));
+    r->timestamps.push_back(timestamp);
+    EXPECT_EQ(sample_interval, 0);
+    return true;
+}
+
+TEST(sd_test, compass_readings) {
+    readings captured;
+    ASSERT_EQ(sd_start(SD_SENSOR_COMPASS, message_sink { readings_callback, &captured }, 1000), 0);
+    *mocks::compass_service() << CompassHeadingData { 1000, 1000, CompassStatusCalibrated, true };
+    psleep(250);
+    *mocks::compass_service() << CompassHeadingData { 2000, 2000, CompassStatusCalibrating, true };
+    psleep(250);
+    // no heading while the data is invalid
+    *mocks::compass_service() << CompassHeadingData { 9999, 9999, CompassStatusDataInvalid, false };
+    psleep(600);
+    EXPECT_TRUE(captured.buffers.empty());
+
+    // the reading 1100 ms after the first one goes to the next buffer
+    *mocks::compass_service() << CompassHeadingData { 3000, 3000, CompassStatusCalibrated, true };
+    ASSERT_EQ(captured.buffers.size(), 1);
+    ASSERT_EQ(captured.buffers[0].size(), 2);
+    EXPECT_EQ(captured.buffers[0][0].offset, 0);
+    EXPECT_EQ(captured.buffers[0][0].value, 1000);
+    EXPECT_NEAR(captured.buffers[0][1].offset, 250, 20);
+    EXPECT_EQ(captured.buffers[0][1].value, 2000);
+
+    EXPECT_EQ(sd_stop(SD_SENSOR_COMPASS), 1);
+    ASSERT_EQ(captured.buffers.size(), 2);
+    ASSERT_EQ(captured.buffers[1].size(), 1);
+    EXPECT_EQ(captured.buffers[1][0].offset, 0);
+    EXPECT_EQ(captured.buffers[1][0].value, 3000);
+    EXPECT_NEAR(captured.timestamps[1] - captured.timestamps[0], 1.1, 0.02);
+
+    // stopped, the service delivers nothing
+    *mocks::compass_service() << CompassHeadingData { 4000, 4000, CompassStatusCalibrated, true };
+    EXPECT_EQ(captured.buffers.size(), 2);
+}
+
+TEST(sd_test, restart_keeps_recording) {
+    readings first, second;
+    ASSERT_EQ(sd_start(SD_SENSOR_COMPASS, message_sink { readings_callback, &first }, 1000), 0);
+    *mocks::compass_service() << CompassHeadingData { 1000, 1000, CompassStatusCalibrated, true };
+    psleep(300);
+
+    // the new session's sink gets the readings from now on, in buffers of at most 200 ms
+    ASSERT_EQ(sd_start(SD_SENSOR_COMPASS, message_sink { readings_callback, &second }, 200), 0);
+    ASSERT_EQ(first.buffers.size(), 1);
+    EXPECT_EQ(first.buffers[0][0].value, 1000);
+    *mocks::compass_service() << CompassHeadingData { 2000, 2000, CompassStatusCalibrated, true };
+    psleep(300);
+    *mocks::compass_service() << CompassHeadingData { 3000, 3000, CompassStatusCalibrated, true };
+    EXPECT_EQ(sd_stop(SD_SENSOR_COMPASS), 1);
+
+    EXPECT_EQ(first.buffers.size(), 1);
+    ASSERT_EQ(second.buffers.size(), 2);
+    EXPECT_EQ(second.buffers[0][0].value, 2000);
+    EXPECT_EQ(second.buffers[1][0].value, 3000);
+}
+
+#if defined(PBL_HEALTH)
+TEST(sd_test, heart_rate_readings) {
+    readings captured;
+    ASSERT_EQ(sd_start(SD_SENSOR_HEART_RATE, message_sink { readings_callback, &captured }, 5000), 0);
+    *mocks::health_service() << 72;
+    psleep(1000);
+    // no reading yet
+    *mocks::health_service() << 0;
+    psleep(1000);
+    *mocks::health_service() << 75;
+    EXPECT_EQ(sd_stop(SD_SENSOR_HEART_RATE), 1);
+
+    ASSERT_EQ(captured.buffers.size(), 1);
+    ASSERT_EQ(captured.buffers[0].size(), 2);
+    EXPECT_EQ(captured.buffers[0][0].offset, 0);
+    EXPECT_EQ(captured.buffers[0][0].value, 72);
+    EXPECT_NEAR(captured.buffers[0][1].offset, 2000, 20);
+    EXPECT_EQ(captured.buffers[0][1].value, 75);
+}
+#endif
+
+TEST(sd_test, decoded_readings) {
+    mocks::reset();
+    auto am = am_start(AD_TYPE_ACCELEROMETER, 50, sizeof(threed_data));
+    auto sink = am_add_stream(am, SD_TYPE_COMPASS, 0, sizeof(sensor_data), 1);
+    ASSERT_EQ(sd_start(SD_SENSOR_COMPASS, sink, 1000), 0);
+    for (int i = 0; i < 3; ++i) {
+        *mocks::compass_service() << CompassHeadingData { 100 * i, 100 * i, CompassStatusCalibrated, true };
+        psleep(300);
+    }
+    sd_stop(SD_SENSOR_COMPASS);
+    auto message = mocks::app_messages()->last_dict().get<std::vector<uint8_t>>(msg_ad);
+    am_stop(am);
+
+    // every reading at its own time from the batch's timestamp
+    auto batch = muvr::decode(message);
+    EXPECT_EQ(batch.type, SD_TYPE_COMPASS);
+    ASSERT_EQ(batch.samples.size(), 3);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NEAR(batch.samples[i].time - batch.samples[0].time, 300 * i, 20);
+        EXPECT_EQ(batch.samples[i].x, 100 * i);
+    }
+}
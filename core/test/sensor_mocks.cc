@@ -0,0 +1,69 @@
+#include "sensor_mocks.h"
+
+using namespace pebble::mocks;
+
+static CompassHeadingHandler compass_handler;
+
+extern "C" {
+
+void compass_service_subscribe(CompassHeadingHandler handler) {
+    compass_handler = handler;
+}
+
+void compass_service_unsubscribe(void) {
+    compass_handler = nullptr;
+}
+
+int compass_service_set_heading_filter(CompassHeading filter) {
+    return 0;
+}
+
+}
+
+compass_service_t *pebble::mocks::compass_service() {
+    static compass_service_t service;
+    return &service;
+}
+
+compass_service_t &compass_service_t::operator<<(const CompassHeadingData &heading) {
+    if (compass_handler != nullptr) compass_handler(heading);
+    return *this;
+}
+
+#if defined(PBL_HEALTH)
+static HealthEventHandler health_handler;
+static HealthValue heart_rate;
+
+extern "C" {
+
+bool health_service_events_subscribe(HealthEventHandler handler, void *context) {
+    health_handler = handler;
+    return true;
+}
+
+bool health_service_events_unsubscribe(void) {
+    health_handler = nullptr;
+    return true;
+}
+
+HealthValue health_service_peek_current_value(HealthMetric metric) {
+    return metric == HealthMetricHeartRateBPM ? heart_rate : 0;
+}
+
+bool health_service_set_heart_rate_sample_period(uint16_t interval_sec) {
+    return true;
+}
+
+}
+
+health_service_t *pebble::mocks::health_service() {
+    static health_service_t service;
+    return &service;
+}
+
+health_service_t &health_service_t::operator<<(const HealthValue bpm) {
+    heart_rate = bpm;
+    if (health_handler != nullptr) health_handler(HealthEventHeartRateUpdate, nullptr);
+    return *this;
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#include <pebble.h>
+
+///
+/// The compass and health services, which pebble-mock does not have; their readings go to the
+/// handlers the watch code subscribed, as pebble-mock's ``accel_service()`` does for the samples.
+///
+namespace pebble {
+
+    namespace mocks {
+
+        class compass_service_t {
+        public:
+            ///
+            /// Delivers the ``heading`` to the subscribed handler, if any
+            ///
+            compass_service_t &operator<<(const CompassHeadingData &heading);
+        };
+
+        compass_service_t *compass_service();
+
+#if defined(PBL_HEALTH)
+        class health_service_t {
+        public:
+            ///
+            /// Makes the ``bpm`` the current heart rate, and tells the subscribed handler, if any
+            ///
+            health_service_t &operator<<(const HealthValue bpm);
+        };
+
+        health_service_t *health_service();
+#endif
+
+    }
+
+}
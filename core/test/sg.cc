@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include "sg.h"
+
+class sg_test : public testing::Test {
+protected:
+    sg_generator generator;
+
+    virtual void SetUp() {
+        memset(&generator, 0, sizeof(generator));
+    }
+
+    /// the ``count`` samples of the signal at 100 Hz from ``timestamp``
+    std::vector<AccelRawData> fill(const uint32_t count, const uint64_t timestamp) {
+        std::vector<AccelRawData> data(count, AccelRawData { 1, 2, 3 });
+        sg_fill(&generator, data.data(), count, timestamp, 10 << 8);
+        return data;
+    }
+};
+
+TEST_F(sg_test, none_keeps_the_samples) {
+    EXPECT_EQ(sg_start(&generator, SG_SIGNAL_NONE, 0), 0);
+    auto data = fill(3, 1000);
+    EXPECT_EQ(data[2].x, 1);
+    EXPECT_EQ(data[2].z, 3);
+    EXPECT_EQ(sg_start(&generator, SG_SIGNAL_PATTERN + 1, 0), E_SG_INVALID_SIGNAL);
+    EXPECT_EQ(sg_start(&generator, SG_SIGNAL_PATTERN, 0), E_SG_INVALID_SIGNAL);
+}
+
+TEST_F(sg_test, sine) {
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_SINE, 0), 0);
+    // a quarter of a second, then half a second after the start
+    auto data = fill(51, 1449000000000);
+    EXPECT_EQ(data[0].x, 0);
+    EXPECT_EQ(data[0].z, SG_AMPLITUDE);
+    EXPECT_EQ(data[25].x, SG_AMPLITUDE);
+    EXPECT_EQ(data[25].z, 0);
+    EXPECT_EQ(data[50].x, 0);
+    EXPECT_EQ(data[50].z, -SG_AMPLITUDE);
+    for (auto &s : data) EXPECT_NEAR(std::sqrt(s.x * s.x + s.z * s.z), SG_AMPLITUDE, 2);
+
+    // the time goes on across the updates
+    auto next = fill(1, 1449000000000 + 750);
+    EXPECT_EQ(next[0].x, -SG_AMPLITUDE);
+}
+
+TEST_F(sg_test, chirp_speeds_up) {
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_CHIRP, 0), 0);
+    auto data = fill(1000, 0);
+    // the zero crossings of x in the first and the last second of the sweep
+    auto crossings = [&data](size_t from, size_t to) {
+        int count = 0;
+        for (size_t i = from + 1; i < to; ++i) if ((data[i - 1].x < 0) != (data[i].x < 0)) ++count;
+        return count;
+    };
+    EXPECT_LE(crossings(0, 100), 3);
+    EXPECT_GE(crossings(900, 1000), 16);
+    EXPECT_EQ(data[500].z, -1000);
+}
+
+TEST_F(sg_test, step) {
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_STEP, 0), 0);
+    auto data = fill(250, 5);
+    EXPECT_EQ(data[99].x, 0);
+    EXPECT_EQ(data[100].x, SG_AMPLITUDE);
+    EXPECT_EQ(data[199].x, SG_AMPLITUDE);
+    EXPECT_EQ(data[200].x, 0);
+}
+
+TEST_F(sg_test, noise_is_deterministic) {
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_NOISE, 7), 0);
+    auto first = fill(500, 1000);
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_NOISE, 7), 0);
+    auto again = fill(500, 99000);
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_NOISE, 8), 0);
+    auto other = fill(500, 1000);
+
+    int differ = 0;
+    double mean = 0;
+    for (size_t i = 0; i < first.size(); ++i) {
+        EXPECT_EQ(first[i].x, again[i].x);
+        EXPECT_EQ(first[i].z, again[i].z);
+        EXPECT_LE(std::abs(first[i].y), SG_AMPLITUDE);
+        if (first[i].x != other[i].x) ++differ;
+        mean += first[i].x;
+    }
+    EXPECT_GT(differ, 490);
+    EXPECT_NEAR(mean / first.size(), 0, 100);
+}
+
+TEST_F(sg_test, pattern) {
+    const AccelRawData pattern[] = { { 1, 1, 1 }, { 2, 2, 2 }, { 3, 3, 3 } };
+    sg_set_pattern(&generator, pattern, 3, 50);
+    ASSERT_EQ(sg_start(&generator, SG_SIGNAL_PATTERN, 0), 0);
+
+    // at twice the rate of the pattern, every recorded sample twice
+    auto data = fill(8, 0);
+    const int16_t expected[] = { 1, 1, 2, 2, 3, 3, 1, 1 };
+    for (int i = 0; i < 8; ++i) EXPECT_EQ(data[i].y, expected[i]);
+
+    sg_set_pattern(&generator, nullptr, 0, 0);
+    EXPECT_EQ(generator.signal, SG_SIGNAL_NONE);
+}
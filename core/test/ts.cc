@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "ts.h"
+
+class ts_test : public testing::Test {
+protected:
+    ts_state state;
+
+    virtual void SetUp() {
+        ts_reset(&state);
+    }
+};
+
+TEST_F(ts_test, not_synchronised) {
+    EXPECT_FALSE(ts_synchronised(&state));
+    EXPECT_EQ(ts_phone_time(&state, 1449000000000), 1449000000000);
+}
+
+TEST_F(ts_test, offset) {
+    // the phone is 5 s ahead; 50 ms there, 50 ms back
+    EXPECT_EQ(ts_add(&state, 1000, 6050, 6060, 1110), 0);
+    EXPECT_TRUE(ts_synchronised(&state));
+    EXPECT_EQ(ts_phone_time(&state, 2000), 7000);
+
+    // a slower exchange does not replace the better estimate
+    EXPECT_EQ(ts_add(&state, 3000, 8400, 8410, 3800), 0);
+    EXPECT_EQ(ts_phone_time(&state, 2000), 7000);
+
+    // the phone cannot take longer to reply than the whole round-trip
+    EXPECT_EQ(ts_add(&state, 4000, 9000, 9200, 4100), E_TS_INVALID);
+    EXPECT_EQ(ts_add(&state, 4000, 9000, 9010, 3900), E_TS_INVALID);
+}
+
+TEST_F(ts_test, drift) {
+    // the phone clock runs 100 ppm faster, the delays are 20 ms
+    for (int64_t t = 0; t < TS_WINDOW; t++) {
+        int64_t watch = 1449000000000 + t * 30000;
+        int64_t phone = watch + 5000 + t * 3;
+        EXPECT_EQ(ts_add(&state, watch, phone + 10, phone + 10, watch + 20), 0);
+    }
+    EXPECT_EQ(state.drift, 100);
+
+    int64_t later = 1449000000000 + 30000 * TS_WINDOW + 600000;
+    EXPECT_NEAR(ts_phone_time(&state, later), later + 5000 + (30000 * TS_WINDOW + 600000) / 10000, 1);
+}
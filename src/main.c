@@ -1,13 +1,156 @@
 #include <pebble.h>
 #include "../core/main/ad.h"
 #include "../core/main/am.h"
+#include "../core/main/bp.h"
+#include "../core/main/lg.h"
+#include "../core/main/sd.h"
 
 #include "main_window.h"
 
+/**
+ * Reads the session configuration from the payload of ``t``; a payload that is not
+ * a byte array gives the default configuration.
+ */
+static int read_config(const Tuple *t, struct session_config *config) {
+    if (t->type != TUPLE_BYTE_ARRAY) return am_read_config(NULL, 0, config);
+    return am_read_config(t->value->data, t->length, config);
+}
+
+// the configuration of the running session and the battery profile applied to it
+static struct session_config session;
+static bp_profile_t session_profile;
+// the capture and transport pipelines of the running session
+static ad_t *capture;
+static am_t *transport;
+
+/**
+ * Applies the ``session`` configuration reduced by the ``session_profile`` to ad and am.
+ * ad submits the samples it holds in the old setting before am stamps the new one.
+ */
+static int apply_session(void) {
+    uint8_t rate = session.samples_per_second;
+    uint8_t mode = AD_MODE_RAW;
+    switch (session_profile) {
+        case bp_full: break;
+        case bp_decimated: rate = bp_reduced_rate(rate); break;
+        case bp_gated: rate = bp_reduced_rate(rate); mode = AD_MODE_GATED; break;
+        case bp_features: rate = bp_reduced_rate(rate); mode = AD_MODE_FEATURES; break;
+    }
+
+    int result;
+    if ((result = ad_reconfigure(capture, rate, session.maximum_time)) != 0) return result;
+    if ((result = ad_set_mode(capture, mode)) != 0) return result;
+    if ((result = ad_set_encoding(capture, session.encoding, session.range)) != 0) return result;
+    if (mode == AD_MODE_FEATURES) {
+        am_reconfigure(transport, AD_TYPE_FEATURES, rate, sizeof(struct threed_features), AD_FEATURES_VALUES);
+        am_set_encoding(transport, AD_ENCODING_PACKED, 0);
+    } else {
+        am_reconfigure(transport, AD_TYPE_ACCELEROMETER, rate, sizeof(struct threed_data), 3);
+        am_set_encoding(transport, session.encoding, session.range);
+    }
+    return 0;
+}
+
+/**
+ * Starts the recording of the sensors in the ``session`` types and stops the others.
+ * Their readings share the transport with the accelerometer samples, each stream with its own type.
+ */
+static void apply_streams(void) {
+    static const struct { uint8_t stream; uint8_t sensor; uint32_t type; } sensors[] = {
+        { AM_STREAM_HEART_RATE, SD_SENSOR_HEART_RATE, SD_TYPE_HEART_RATE },
+        { AM_STREAM_COMPASS, SD_SENSOR_COMPASS, SD_TYPE_COMPASS }
+    };
+    for (size_t i = 0; i < ARRAY_LENGTH(sensors); ++i) {
+        if (session.types & sensors[i].stream) {
+            struct message_sink sink = am_add_stream(transport, sensors[i].type, 0, sizeof(struct sensor_data), 1);
+            if (sink.callback != NULL) sd_start(sensors[i].sensor, sink, session.maximum_time);
+        } else {
+            sd_stop(sensors[i].sensor);
+        }
+    }
+}
+
+static void battery_profile_changed(const bp_profile_t profile) {
+    session_profile = profile;
+    apply_session();
+}
+
+static void start_battery_policy(void) {
+    struct bp_thresholds thresholds = { session.decimated_below, session.gated_below, session.features_below };
+    bp_start(&thresholds, battery_profile_changed);
+}
+
+static void stop_recording(void);
+
+static void start_recording(const Tuple *t) {
+    // a rejected command keeps the running session as it is
+    struct session_config config;
+    if (read_config(t, &config) != 0) {
+        main_window_set_text("Bad cfg");
+        return;
+    }
+
+    // starting again replaces the running session
+    if (transport != NULL) stop_recording();
+    session = config;
+    if (capture == NULL) capture = ad_open();
+    transport = am_start(AD_TYPE_ACCELEROMETER, session.samples_per_second, sizeof(struct threed_data));
+    if (transport == NULL) {
+        main_window_set_text("No memory");
+        return;
+    }
+    int result = ad_start(capture, am_sink(transport), session.samples_per_second, session.maximum_time);
+    if (result != 1) {
+        // nothing is captured, so the transport goes back to the arena's pool
+        am_stop(transport);
+        transport = NULL;
+        main_window_set_text(result == E_AD_MEM ? "No memory" : "Not ready");
+        return;
+    }
+    am_set_ack_window(transport, session.ack_window);
+    am_set_fec_group(transport, session.fec_group);
+    ad_set_standby(capture, session.standby);
+    apply_streams();
+    session_profile = bp_full;
+    start_battery_policy();
+    main_window_set_text("Ready");
+}
+
+static void reconfigure_recording(const Tuple *t) {
+    struct session_config config;
+    if (read_config(t, &config) != 0) {
+        main_window_set_text("Bad cfg");
+        return;
+    }
+
+    struct session_config previous = session;
+    session = config;
+    if (apply_session() != 0) {
+        session = previous;
+        main_window_set_text("Not ready");
+        return;
+    }
+    // the thresholds, the acknowledgements, the standby and the streams may have changed, too
+    am_set_ack_window(transport, session.ack_window);
+    am_set_fec_group(transport, session.fec_group);
+    ad_set_standby(capture, session.standby);
+    apply_streams();
+    start_battery_policy();
+}
+
+static void stop_recording(void) {
+    bp_stop();
+    ad_stop(capture);
+    sd_stop(SD_SENSOR_HEART_RATE);
+    sd_stop(SD_SENSOR_COMPASS);
+    am_stop(transport);
+    transport = NULL;
+}
+
 static void app_message_received(DictionaryIterator *iterator, void *context) {
     Tuple *t = dict_read_first(iterator);
     while (t != NULL) {
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "Received %lx", t->key);
+        LG_DEBUG(LG_MAIN_RECEIVED, t->key);
         switch (t->key) {
             case 0xa0000000: // notify-not-moving
                 main_window_set_text("...");
@@ -25,16 +168,32 @@ static void app_message_received(DictionaryIterator *iterator, void *context) {
                 main_window_set_text("** Done **");
 
                 break;
-            case 0xb0000000: {
-                // start recording
-                message_callback_t message_callback = am_start(0x516c6174, 50, sizeof(struct threed_data));
-                ad_start(message_callback, 50, 1000);
-                main_window_set_text("Ready");
-                }
+            case 0xb0000000: // start recording
+                start_recording(t);
                 break;
             case 0xb0000001: // stop recording
+                stop_recording();
                 main_window_set_text("Stopped");
                 break;
+            case 0xb0000002: // reconfigure recording
+                reconfigure_recording(t);
+                break;
+            case 0xb0000003: // clock synchronisation reply
+                if (t->type == TUPLE_BYTE_ARRAY) am_time_sync_received(transport, t->value->data, t->length);
+                break;
+            case 0xb0000004: // sample batches acknowledgement
+                if (t->type == TUPLE_BYTE_ARRAY) am_ack_received(transport, t->value->data, t->length);
+                break;
+            case 0xb0000005: // log dump request
+                // the dump would take the outbox from the recording's messages
+                if (transport != NULL || lg_send() != 0) main_window_set_text("Log busy");
+                break;
+            case 0xb0000006: // corrupted sample batches
+                if (t->type == TUPLE_BYTE_ARRAY) am_resend_requested(transport, t->value->data, t->length);
+                break;
+            case 0xb0000007: // synthetic signal instead of the accelerometer
+                if (t->type != TUPLE_BYTE_ARRAY || t->length < 1 || ad_set_signal(t->value->data[0]) != 0) main_window_set_text("Bad signal");
+                break;
             default:
                 main_window_set_text("???");
                 break;
@@ -50,8 +209,7 @@ static void init(void) {
 }
 
 static void deinit(void) {
-    ad_stop();
-    am_stop();
+    stop_recording();
     app_message_deregister_callbacks();
 
     main_window_deinit();
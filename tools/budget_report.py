@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+#
+# Reports the stack and heap budget of the watch code from a host build made with
+# -DPEBBLE_STACK_USAGE=ON, which compiles pebble-core and pebble-ui with -fstack-usage
+# (and -fcallgraph-info=su on gcc). The frame sizes come from the host compiler, so
+# they are an estimate of the ARM frames, good enough to spot the large ones.
+#
+# usage: budget_report.py <build dir> <mm.h> [--limit B] [--edge caller:callee]... [--root function]...
+#
+
+import argparse
+import os
+import re
+import sys
+
+NODE = re.compile(r'node: \{ title: "([^"]+)" label: "([^"\\]+)(?:\\n([^"\\]*))?(?:\\n(\d+) bytes)?[^"]*"')
+EDGE = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+SU = re.compile(r'^(.*):\d+:\d+:(\S+)\t(\d+)\t(\S+)$')
+BUDGET = re.compile(r'#define (MM_\w+_BUDGET) (\d+)')
+INSTANCES = re.compile(r'#define (MM_\w+)_INSTANCES (\d+)')
+HEAP = {'malloc', 'calloc', 'realloc', 'free'}
+
+
+def name_of(title):
+    # static functions are titled "file:function", with the optimiser's .part/.isra suffixes
+    return title.rsplit(':', 1)[-1].split('.')[0]
+
+
+def load(build_dir):
+    frames, qualifiers, edges, defined = {}, {}, {}, set()
+    for root, _, files in os.walk(build_dir):
+        for f in files:
+            path = os.path.join(root, f)
+            if f.endswith('.su'):
+                for line in open(path):
+                    m = SU.match(line.strip())
+                    if m:
+                        name = m.group(2).split('.')[0]
+                        frames[name] = max(frames.get(name, 0), int(m.group(3)))
+                        qualifiers[name] = m.group(4)
+            elif f.endswith('.ci'):
+                for line in open(path):
+                    m = NODE.match(line)
+                    if m and m.group(4) is not None:
+                        defined.add(name_of(m.group(1)))
+                    m = EDGE.match(line)
+                    if m:
+                        edges.setdefault(name_of(m.group(1)), set()).add(name_of(m.group(2)))
+    return frames, qualifiers, edges, defined
+
+
+def depth(function, frames, edges, stack=()):
+    """The worst-case stack depth of ``function`` and the path that reaches it"""
+    if function in stack:
+        return 0, [function + ' (recursion)']
+    worst, worst_path = 0, []
+    for callee in sorted(edges.get(function, ())):
+        d, p = depth(callee, frames, edges, stack + (function,))
+        if d > worst:
+            worst, worst_path = d, p
+    return frames.get(function, 0) + worst, [function] + worst_path
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('build_dir')
+    parser.add_argument('mm_h')
+    parser.add_argument('--limit', type=int, default=1024, help='the largest allowed stack depth in B')
+    parser.add_argument('--frame-limit', type=int, default=256, help='the largest frame reported without a warning in B')
+    parser.add_argument('--edge', action='append', default=[], help='calls through function pointers, as caller:callee')
+    parser.add_argument('--root', action='append', default=[], help='the entry points to report')
+    args = parser.parse_args()
+
+    frames, qualifiers, edges, defined = load(args.build_dir)
+    if not frames:
+        print('No .su files in %s; configure with -DPEBBLE_STACK_USAGE=ON' % args.build_dir)
+        return 1
+    for edge in args.edge:
+        caller, callee = edge.split(':')
+        edges.setdefault(caller, set()).add(callee)
+
+    failed = False
+    print('Worst-case stack depth (own frames only, SDK calls not included)')
+    for root in args.root:
+        if root not in frames:
+            print('  %-28s not found' % root)
+            continue
+        d, path = depth(root, frames, edges)
+        over = d > args.limit
+        failed = failed or over
+        print('  %-28s %5d B%s' % (root, d, '  OVER %d B LIMIT' % args.limit if over else ''))
+        print('      ' + ' -> '.join('%s (%d)' % (f, frames.get(f, 0)) for f in path if f in frames))
+    if not edges:
+        print('  no call graph (-fcallgraph-info is gcc only); the depths are the root frames alone')
+
+    print('Large frames')
+    large = sorted(((b, f) for f, b in frames.items() if b > args.frame_limit), reverse=True)
+    for b, f in large:
+        print('  %-28s %5d B %s' % (f, b, qualifiers[f]))
+    if not large:
+        print('  none above %d B' % args.frame_limit)
+
+    print('Heap')
+    heap_users = sorted(f for f, callees in edges.items() if f in defined and callees & HEAP)
+    for f in heap_users:
+        print('  %s calls %s' % (f, ', '.join(sorted(edges[f] & HEAP))))
+    if not heap_users:
+        print('  no heap allocation; all state is in the arena')
+
+    print('Arena')
+    mm_h = open(args.mm_h).read()
+    # the modules without a pipeline count have one
+    instances = {prefix: int(n) for prefix, n in INSTANCES.findall(mm_h)}
+    total = 0
+    for name, size in BUDGET.findall(mm_h):
+        n = instances.get(name[:-len('_BUDGET')], 1)
+        print('  %-28s %5s B x %d' % (name, size, n))
+        total += int(size) * n
+    print('  %-28s %5d B' % ('MM_ARENA_SIZE', total))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
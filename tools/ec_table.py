@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# Generates core/main/ec_table.h, the static Huffman table of the entropy-coded sample
+# encoding, from recorded sessions. Every value is coded as the difference from the previous
+# sample's value on the same axis; the table codes the category of the difference (the number
+# of bits of its magnitude), followed by the category's bits of the difference itself.
+#
+# The sessions are CSV files with the x, y, z values of one sample per line in the last three
+# columns, as written by the phone app; without sessions, the table comes from the default
+# category histogram below.
+#
+# usage: ec_table.py [session.csv]... > core/main/ec_table.h
+#
+
+import csv
+import heapq
+import sys
+
+CATEGORIES = 14
+MAX_LENGTH = 16
+# a placeholder histogram, made up rather than measured, for the table used when no sessions
+# are given; regenerate the table from recorded sessions before relying on its compression ratio
+DEFAULT_HISTOGRAM = [60, 80, 120, 160, 170, 150, 110, 70, 40, 20, 10, 5, 3, 2]
+
+
+def category(difference):
+    return abs(difference).bit_length()
+
+
+def histogram(paths):
+    counts = [0] * CATEGORIES
+    for path in paths:
+        previous = [0, 0, 0]
+        with open(path) as f:
+            for row in csv.reader(f):
+                try:
+                    values = [int(v) for v in row[-3:]]
+                except ValueError:
+                    continue  # the header line
+                for axis, value in enumerate(values):
+                    counts[category(value - previous[axis])] += 1
+                previous = values
+    return counts
+
+
+def lengths(counts):
+    # every category gets a code, even the ones not seen in the sessions
+    heap = [(max(count, 1), [symbol]) for symbol, count in enumerate(counts)]
+    heapq.heapify(heap)
+    result = [0] * len(counts)
+    while len(heap) > 1:
+        a, symbols_a = heapq.heappop(heap)
+        b, symbols_b = heapq.heappop(heap)
+        for symbol in symbols_a + symbols_b:
+            result[symbol] += 1
+        heapq.heappush(heap, (a + b, symbols_a + symbols_b))
+    if max(result) > MAX_LENGTH:
+        sys.exit('the codes are longer than %d bits; flatten the histogram' % MAX_LENGTH)
+    return result
+
+
+def canonical(lengths):
+    codes = [0] * len(lengths)
+    code, previous = 0, 0
+    for length, symbol in sorted((l, s) for s, l in enumerate(lengths)):
+        code <<= length - previous
+        codes[symbol] = code
+        code += 1
+        previous = length
+    return codes
+
+
+def main():
+    counts = histogram(sys.argv[1:]) if len(sys.argv) > 1 else DEFAULT_HISTOGRAM
+    code_lengths = lengths(counts)
+    codes = canonical(code_lengths)
+    print('#pragma once')
+    print('// generated by tools/ec_table.py; do not edit')
+    if len(sys.argv) > 1:
+        print('// the category histogram of %d sessions: %s' % (len(sys.argv) - 1, ', '.join(str(c) for c in counts)))
+    else:
+        print('// the placeholder category histogram, not measured: %s' % ', '.join(str(c) for c in counts))
+    print()
+    print('// the canonical Huffman codes of the categories of the differences, and their lengths in bits')
+    print('static const uint16_t ec_codes[EC_CATEGORIES] = { %s };' % ', '.join('0x%x' % c for c in codes))
+    print('static const uint8_t ec_lengths[EC_CATEGORIES] = { %s };' % ', '.join(str(l) for l in code_lengths))
+
+
+if __name__ == '__main__':
+    main()